@@ -1,8 +1,20 @@
 #include <bst.hpp>
+#include <compact_bst.hpp>
+#include <cached_bst.hpp>
+#include <bst_multimap.hpp>
+#include <string_bst.hpp>
+#include <async_bst.hpp>
+#include <durable_bst.hpp>
+#include <sharded_bst.hpp>
+#include <interval_bst.hpp>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <map>
 #include <chrono>
 #include <random>
 #include <cmath>
+#include <algorithm>
 
 //It would be nice to have a wrapper function handling times and their averages but it would
 //probably be a little painful to generalise it
@@ -17,6 +29,31 @@ void randomRun(const unsigned int &n, const unsigned int &rep, T &object, const
 
 void balancedFind(const unsigned int &n, const unsigned int &rep, bst<int, int, std::less<int>> &object);
 
+void latencyRun(const unsigned int &n, bst<int, int, std::less<int>> &object, const unsigned int &balanceEvery);
+
+template<class T>
+void multimapRun(const unsigned int &n, const unsigned int &keys, const unsigned int &rep, T &object);
+
+void setAlgebraRun(const unsigned int &n, const unsigned int &rep);
+
+void urlRun(const unsigned int &n, const unsigned int &rep);
+
+void asyncRun(const unsigned int &n);
+void durableRun(const unsigned int &n);
+void shardedRun(const unsigned int &n);
+void cursorRun(const unsigned int &n);
+void intervalRun(const unsigned int &n, const unsigned int &queries);
+
+template<class T>
+void zipfFind(const std::vector<int> &queries, const unsigned int &rep, T &object);
+
+template<class T>
+void memoryFind(const unsigned int &n, const unsigned int &rep, T &object, const std::size_t &bytes);
+
+//Bytes taken on the heap by an allocation of the given size with glibc malloc: an 8 bytes header,
+//rounded up to 16 bytes, at least 32
+constexpr std::size_t heapBlock(std::size_t bytes) { return std::max<std::size_t>(32, (bytes + 8 + 15)/16*16); }
+
 
 int main(){
 
@@ -95,6 +132,148 @@ int main(){
     std::cout << N << " balanced finds on bst" << std::endl;
     balancedFind(N, reps, bst1);
 
+    //Compact layout: same random keys in the pointer based tree and in the index based ones
+
+    constexpr unsigned int M = 200000;
+    constexpr unsigned int M_reps = 5;
+    using compact = compact_bst<int, int, std::less<int>>;
+    using compact_joint = compact_bst<int, int, std::less<int>, false>;
+
+    bst bst2{std::less<int>()};
+    compact compact1{std::less<int>()};
+    compact_joint compact2{std::less<int>()};
+    std::mt19937 gen_m(42);
+    std::uniform_int_distribution<> dis_m(1, 4*M);
+    for(unsigned int k = 0; k < M; ++k){
+        auto tmp = dis_m(gen_m);
+        bst2.insert(std::make_pair(tmp,tmp));
+        compact1.insert(std::make_pair(tmp,tmp));
+        compact2.insert(std::make_pair(tmp,tmp));
+    }
+    //both sides count what they really take: one heap block per node for the pointer based tree,
+    //the stores without the spare capacity of the vectors for the compact ones
+    compact1.shrink_to_fit();
+    compact2.shrink_to_fit();
+
+    std::cout << M << " random finds on bst" << std::endl;
+    memoryFind(4*M, M_reps, bst2, bst2.size()*heapBlock(sizeof(node<std::pair<const int,int>>)));
+
+    std::cout << M << " random finds on compact bst (split keys)" << std::endl;
+    memoryFind(4*M, M_reps, compact1, compact1.memoryUsage());
+
+    std::cout << M << " random finds on compact bst (joint keys)" << std::endl;
+    memoryFind(4*M, M_reps, compact2, compact2.memoryUsage());
+
+    compact1.balance();
+    std::cout << M << " random finds on balanced compact bst (split keys)" << std::endl;
+    memoryFind(4*M, M_reps, compact1, compact1.memoryUsage());
+
+    //Per-operation latency: sequential inserts then random erases, the worst single operation
+    //is what a latency-sensitive caller sees
+
+    std::cout << N << " sequential inserts and random erases on bst" << std::endl;
+    latencyRun(N, bst1, 0);
+
+    std::cout << N << " sequential inserts and random erases on bst, balance() every " << N/10 << " inserts" << std::endl;
+    latencyRun(N, bst1, N/10);
+
+    std::cout << N << " sequential inserts and random erases on bst, incremental balance" << std::endl;
+    bst1.setIncrementalBalance(true);
+    latencyRun(N, bst1, 0);
+
+    std::cout << M << " sequential inserts and random erases on bst, incremental balance" << std::endl;
+    latencyRun(M, bst1, 0);
+    bst1.setIncrementalBalance(false);
+
+    //Skewed reads: the rank r of a key is drawn with probability proportional to 1/r^1.2, and the
+    //ranks are shuffled over the keys so that the hot ones are spread in the tree
+
+    std::vector<int> ranks(M);
+    for(unsigned int k = 0; k < M; ++k)
+        ranks[k] = k;
+    std::shuffle(ranks.begin(), ranks.end(), std::mt19937(5));
+    std::vector<double> weights(M);
+    for(unsigned int k = 0; k < M; ++k)
+        weights[k] = std::pow(k+1, -1.2);
+    std::discrete_distribution<unsigned int> zipf(weights.begin(), weights.end());
+    std::vector<int> queries(4*M);
+    for(auto &x : queries)
+        x = ranks[zipf(gen_m)];
+
+    bst bst3{std::less<int>()};
+    std::shuffle(ranks.begin(), ranks.end(), std::mt19937(9));
+    for(auto x : ranks)
+        bst3.insert(std::make_pair(x,x));
+
+    std::cout << queries.size() << " zipfian finds on random bst" << std::endl;
+    zipfFind(queries, M_reps, bst3);
+
+    std::cout << queries.size() << " zipfian finds on map" << std::endl;
+    map map3(bst3.begin(), bst3.end());
+    zipfFind(queries, M_reps, map3);
+
+    bst3.balance();
+    std::cout << queries.size() << " zipfian finds on balanced bst" << std::endl;
+    zipfFind(queries, M_reps, bst3);
+
+    cached_bst<int, int> cached1;
+    for(auto x : ranks)
+        cached1.insert(std::make_pair(x,x));
+    cached1.balance();
+    std::cout << queries.size() << " zipfian finds on balanced bst with hot-key cache" << std::endl;
+    zipfFind(queries, M_reps, cached1);
+
+    bst3.setSelfAdjusting(true);
+    std::cout << queries.size() << " zipfian finds on self-adjusting bst" << std::endl;
+    zipfFind(queries, M_reps, bst3);
+
+    //Duplicated keys: M values over M/4 random keys, then all of them are read back by key
+
+    bst_multimap<int, int> multimap1;
+    std::multimap<int, int> multimap2;
+
+    std::cout << M << " inserts and equal_range over " << M/4 << " keys on bst_multimap" << std::endl;
+    multimapRun(M, M/4, M_reps, multimap1);
+
+    std::cout << M << " inserts and equal_range over " << M/4 << " keys on multimap" << std::endl;
+    multimapRun(M, M/4, M_reps, multimap2);
+
+    //Intersection of two trees of 4N random keys each: the result of find and insert is built
+    //in order, hence unbalanced, and quadratic
+
+    std::cout << "Intersection of two sets of " << 4*N << " keys" << std::endl;
+    setAlgebraRun(4*N, M_reps);
+
+    //String keys sharing long prefixes, as the paths of a routing table
+
+    std::cout << M/2 << " url finds on bst, string_bst and frozen string_bst" << std::endl;
+    urlRun(M/2, M_reps);
+
+    //Reads during a background compaction, while another thread keeps writing
+
+    std::cout << "Reads during the compaction of " << M << " keys" << std::endl;
+    asyncRun(M);
+
+    //Logged writes with different group commits, checkpoint and recovery
+
+    std::cout << "Durable tree with " << M << " keys" << std::endl;
+    durableRun(M);
+
+    //Parallel inserts and finds: one locked bst against 16 shards
+
+    std::cout << M << " inserts and finds split among threads" << std::endl;
+    shardedRun(M);
+
+    //Export in batches while a writer erases and inserts between them
+
+    std::cout << "Export of " << M << " keys: plain iteration against a cursor with writes between batches" << std::endl;
+    cursorRun(M);
+
+    //Overlap queries: interval tree against a scan of the bst keyed by start
+
+    std::cout << "Overlap queries on " << 5*M << " intervals" << std::endl;
+    intervalRun(5*M, 50);
+
 }
 
 template<class T>
@@ -259,4 +438,523 @@ void balancedFind(const unsigned int &n, const unsigned int &rep, bst<int, int,
     std::cout << "Average: " << avg << " (ms)" << std::endl;  
     std::cout << "Std Deviation: " << std_dev << " (ms)" << std::endl << std::endl;  
 
-}
\ No newline at end of file
+}
+
+template<class T>
+void memoryFind(const unsigned int &n, const unsigned int &rep, T &object, const std::size_t &bytes){
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> dis(1, n);
+    std::vector<int> keys(n);
+    for(auto &x : keys)
+        x = dis(gen);
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    double avg = 0;
+    double avg_2 = 0;
+    std::size_t found = 0;
+
+    for(unsigned int i = 0; i < rep; ++i){
+
+        begin = std::chrono::steady_clock::now();
+
+        for(auto x : keys)
+            found += (object.find(x) != object.end());
+
+        end = std::chrono::steady_clock::now();
+        avg += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+        avg_2 += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count()
+                *std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+    }
+
+    avg = static_cast<double>(avg)/rep;
+    avg_2 = static_cast<double>(avg_2)/rep;
+    auto std_dev = avg_2 - avg*avg;
+
+    std::cout << "Memory: " << bytes/1024 << " (KiB)" << std::endl;
+    std::cout << "Hits: " << found/rep << std::endl;
+    std::cout << "Average: " << avg << " (ms)" << std::endl;
+    std::cout << "Std Deviation: " << std_dev << " (ms)" << std::endl << std::endl;
+
+}
+
+void latencyRun(const unsigned int &n, bst<int, int, std::less<int>> &object, const unsigned int &balanceEvery){
+
+    std::vector<int> keys(n);
+    for(unsigned int k = 0; k < n; ++k)
+        keys[k] = k;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    std::vector<double> latencies; //microseconds
+    latencies.reserve(2*n);
+
+    auto total_begin = std::chrono::steady_clock::now();
+    object.clear();
+    for(unsigned int k = 0; k < n; ++k){
+        begin = std::chrono::steady_clock::now();
+        object.insert(std::make_pair(k,k));
+        if(balanceEvery && (k+1) % balanceEvery == 0)
+            object.balance();
+        end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro> (end - begin).count());
+    }
+    for(auto x : keys){
+        begin = std::chrono::steady_clock::now();
+        object.erase(x);
+        end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro> (end - begin).count());
+    }
+    auto total_end = std::chrono::steady_clock::now();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "Total: " << std::chrono::duration_cast<std::chrono::milliseconds> (total_end - total_begin).count() << " (ms)" << std::endl;
+    std::cout << "99.9th percentile: " << latencies[latencies.size()*999/1000] << " (us)" << std::endl;
+    std::cout << "Worst operation: " << latencies.back() << " (us)" << std::endl << std::endl;
+
+}
+
+template<class T>
+void zipfFind(const std::vector<int> &queries, const unsigned int &rep, T &object){
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    double avg = 0;
+    double avg_2 = 0;
+    std::size_t found = 0;
+
+    for(unsigned int i = 0; i < rep; ++i){
+
+        begin = std::chrono::steady_clock::now();
+
+        for(auto x : queries)
+            found += (object.find(x) != object.end());
+
+        end = std::chrono::steady_clock::now();
+        avg += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+        avg_2 += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count()
+                *std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+    }
+
+    avg = static_cast<double>(avg)/rep;
+    avg_2 = static_cast<double>(avg_2)/rep;
+    auto std_dev = avg_2 - avg*avg;
+
+    std::cout << "Hits: " << found/rep << std::endl;
+    std::cout << "Average: " << avg << " (ms)" << std::endl;
+    std::cout << "Std Deviation: " << std_dev << " (ms)" << std::endl << std::endl;
+
+}
+
+template<class T>
+void multimapRun(const unsigned int &n, const unsigned int &keys, const unsigned int &rep, T &object){
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> dis(1, keys);
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point middle;
+    std::chrono::steady_clock::time_point end;
+    double avg_insert = 0;
+    double avg_range = 0;
+    long long sum = 0;
+
+    for(unsigned int i = 0; i < rep; ++i){
+
+        begin = std::chrono::steady_clock::now();
+
+        object.clear();
+        for(unsigned int k = 0; k < n; ++k){
+            auto tmp = dis(gen);
+            object.insert(std::make_pair(tmp,tmp));
+        }
+
+        middle = std::chrono::steady_clock::now();
+
+        for(unsigned int k = 1; k <= keys; ++k){
+            auto range = object.equal_range(k);
+            for(auto it = range.first; it != range.second; ++it)
+                sum += (*it).second;
+        }
+
+        end = std::chrono::steady_clock::now();
+        avg_insert += std::chrono::duration_cast<std::chrono::milliseconds> (middle - begin).count();
+        avg_range += std::chrono::duration_cast<std::chrono::milliseconds> (end - middle).count();
+    }
+
+    std::cout << "Checksum: " << sum/rep << std::endl;
+    std::cout << "Average insert: " << avg_insert/rep << " (ms)" << std::endl;
+    std::cout << "Average equal_range: " << avg_range/rep << " (ms)" << std::endl << std::endl;
+
+}
+
+void setAlgebraRun(const unsigned int &n, const unsigned int &rep){
+
+    std::mt19937 gen(13);
+    std::uniform_int_distribution<> dis(1, 2*n);
+    bst<int, int, std::less<int>> a;
+    bst<int, int, std::less<int>> b;
+    for(unsigned int k = 0; k < n; ++k){
+        auto tmp = dis(gen);
+        a.insert(std::make_pair(tmp,tmp));
+        tmp = dis(gen);
+        b.insert(std::make_pair(tmp,tmp));
+    }
+    std::vector<std::pair<int,int>> sorted_a(a.cbegin(), a.cend());
+    std::vector<std::pair<int,int>> sorted_b(b.cbegin(), b.cend());
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    double avg_find = 0;
+    double avg_intersect = 0;
+    double avg_std = 0;
+    std::size_t sizes[3] = {0, 0, 0};
+
+    for(unsigned int i = 0; i < rep; ++i){
+
+        //find per element and insert, as done so far
+        begin = std::chrono::steady_clock::now();
+        bst<int, int, std::less<int>> result;
+        for(auto it = a.cbegin(); it != a.cend(); ++it)
+            if(b.find((*it).first) != b.end())
+                result.insert(*it);
+        end = std::chrono::steady_clock::now();
+        avg_find += std::chrono::duration<double, std::milli> (end - begin).count();
+        sizes[0] = result.size();
+
+        begin = std::chrono::steady_clock::now();
+        auto merged = intersect(a, b);
+        end = std::chrono::steady_clock::now();
+        avg_intersect += std::chrono::duration<double, std::milli> (end - begin).count();
+        sizes[1] = merged.size();
+
+        begin = std::chrono::steady_clock::now();
+        std::vector<std::pair<int,int>> common;
+        std::set_intersection(sorted_a.begin(), sorted_a.end(), sorted_b.begin(), sorted_b.end(), std::back_inserter(common),
+                              [](const std::pair<int,int> &x, const std::pair<int,int> &y){ return x.first < y.first; });
+        end = std::chrono::steady_clock::now();
+        avg_std += std::chrono::duration<double, std::milli> (end - begin).count();
+        sizes[2] = common.size();
+    }
+
+    std::cout << "Common keys: " << sizes[0] << " " << sizes[1] << " " << sizes[2] << std::endl;
+    std::cout << "Average find and insert: " << avg_find/rep << " (ms)" << std::endl;
+    std::cout << "Average intersect: " << avg_intersect/rep << " (ms)" << std::endl;
+    std::cout << "Average std::set_intersection on sorted vectors: " << avg_std/rep << " (ms)" << std::endl << std::endl;
+
+}
+
+void urlRun(const unsigned int &n, const unsigned int &rep){
+
+    const std::string resources[] = {"customers", "orders", "invoices", "products"};
+    std::mt19937 gen(17);
+    std::vector<std::string> urls;
+    for(unsigned int k = 0; k < n; ++k)
+        urls.push_back("/v1/" + resources[gen() % 4] + "/" + std::to_string(k) + "/" + resources[gen() % 4]);
+    std::shuffle(urls.begin(), urls.end(), gen);
+
+    bst<std::string, int, std::less<std::string>> plain;
+    string_bst<int> compressed;
+    for(unsigned int k = 0; k < n; ++k){
+        plain.insert(std::make_pair(urls[k], k));
+        compressed.insert(std::make_pair(urls[k], k));
+    }
+    plain.balance();
+    compressed.balance();
+    auto frozen = compressed.freeze();
+
+    //the std::string keeps up to 15 bytes inline, otherwise it allocates the string and its terminator
+    std::size_t plain_bytes = plain.size()*sizeof(node<std::pair<const std::string,int>>);
+    for(auto it = plain.cbegin(); it != plain.cend(); ++it)
+        if((*it).first.size() > 15)
+            plain_bytes += (*it).first.size() + 1;
+
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    double avg[3] = {0, 0, 0};
+    std::size_t found[3] = {0, 0, 0};
+
+    for(unsigned int i = 0; i < rep; ++i){
+        std::shuffle(urls.begin(), urls.end(), gen);
+
+        begin = std::chrono::steady_clock::now();
+        for(auto &x : urls)
+            found[0] += (plain.find(x) != plain.end());
+        end = std::chrono::steady_clock::now();
+        avg[0] += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        for(auto &x : urls)
+            found[1] += (compressed.find(x) != compressed.end());
+        end = std::chrono::steady_clock::now();
+        avg[1] += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        for(auto &x : urls)
+            found[2] += (frozen.find(x) != nullptr);
+        end = std::chrono::steady_clock::now();
+        avg[2] += std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count();
+    }
+
+    std::cout << "Hits: " << found[0]/rep << " " << found[1]/rep << " " << found[2]/rep << std::endl;
+    std::cout << "Memory per key bst: " << plain_bytes/n << " (bytes)" << std::endl;
+    std::cout << "Memory per key string_bst: " << compressed.memoryUsage()/n << " (bytes)" << std::endl;
+    std::cout << "Memory per key frozen: " << frozen.memoryUsage()/n << " (bytes)" << std::endl;
+    std::cout << "Average bst: " << avg[0]/rep << " (ms)" << std::endl;
+    std::cout << "Average string_bst: " << avg[1]/rep << " (ms)" << std::endl;
+    std::cout << "Average frozen: " << avg[2]/rep << " (ms)" << std::endl << std::endl;
+
+}
+
+void asyncRun(const unsigned int &n){
+
+    std::mt19937 gen(19);
+    std::uniform_int_distribution<> dis(1, 2*n);
+    async_bst<int, int> object;
+    bst<int, int, std::less<int>> reference;
+    for(unsigned int k = 0; k < n; ++k){
+        auto tmp = dis(gen);
+        object.assign(tmp, tmp);
+        reference.insert(std::make_pair(tmp, tmp));
+    }
+    object.compact();
+    object.wait();
+
+    //what a blocking balance() would cost to every reader
+    auto begin = std::chrono::steady_clock::now();
+    reference.balance();
+    auto end = std::chrono::steady_clock::now();
+    auto blocking = std::chrono::duration<double, std::milli> (end - begin).count();
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&object, &stop, n](){
+        std::mt19937 gen(23);
+        std::uniform_int_distribution<> dis(1, 2*n);
+        while(!stop){
+            auto tmp = dis(gen);
+            object.assign(tmp, tmp);
+        }
+    });
+
+    std::vector<double> latencies; //microseconds
+    std::size_t found = 0;
+    int value;
+    auto start = std::chrono::steady_clock::now();
+    object.compact();
+    do {
+        for(unsigned int k = 0; k < 64; ++k){
+            auto tmp = dis(gen);
+            begin = std::chrono::steady_clock::now();
+            found += object.find(tmp, value);
+            end = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::micro> (end - begin).count());
+        }
+    } while(object.compacting());
+    auto swap = std::chrono::steady_clock::now();
+    stop = true;
+    writer.join();
+    object.wait();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "Reads: " << latencies.size() << " (" << found << " hits)" << std::endl;
+    std::cout << "Time to swap: " << std::chrono::duration<double, std::milli> (swap - start).count() << " (ms)" << std::endl;
+    std::cout << "Read 99th percentile: " << latencies[latencies.size()*99/100] << " (us)" << std::endl;
+    std::cout << "Read 99.9th percentile: " << latencies[latencies.size()*999/1000] << " (us)" << std::endl;
+    std::cout << "Worst read: " << latencies.back() << " (us)" << std::endl;
+    std::cout << "Blocking balance() of the same tree: " << blocking << " (ms)" << std::endl << std::endl;
+
+}
+
+void durableRun(const unsigned int &n){
+
+    const std::string path = "durable_benchmark";
+    auto cleanup = [&path](){
+        std::remove((path + ".log").c_str());
+        std::remove((path + ".ckpt").c_str());
+    };
+    std::mt19937 gen(29);
+    std::uniform_int_distribution<> dis(1, 2*n);
+
+    //a single fsync per write is slow enough to be measured on fewer writes
+    const std::size_t batches[] = {1, 64, 1024};
+    for(auto batch : batches){
+        cleanup();
+        durable_options options;
+        options.batch = batch;
+        auto writes = (batch == 1) ? n/100 : n;
+        durable_bst<int, int> object{path, options};
+        auto begin = std::chrono::steady_clock::now();
+        for(unsigned int k = 0; k < writes; ++k){
+            auto tmp = dis(gen);
+            object[tmp] = tmp;
+        }
+        object.commit();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Writes/s, fdatasync every " << batch << ": " << writes / std::chrono::duration<double> (end - begin).count() << std::endl;
+    }
+
+    cleanup();
+    durable_options options;
+    options.sync = false;
+    {
+        durable_bst<int, int> object{path, options};
+        auto begin = std::chrono::steady_clock::now();
+        for(unsigned int k = 0; k < n; ++k){
+            auto tmp = dis(gen);
+            object[tmp] = tmp;
+        }
+        object.commit();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Writes/s, no fdatasync: " << n / std::chrono::duration<double> (end - begin).count() << std::endl;
+
+        begin = std::chrono::steady_clock::now();
+        object.checkpoint();
+        end = std::chrono::steady_clock::now();
+        std::cout << "Checkpoint of " << object.size() << " keys: " << std::chrono::duration<double, std::milli> (end - begin).count() << " (ms)" << std::endl;
+
+        for(unsigned int k = 0; k < n/10; ++k){
+            auto tmp = dis(gen);
+            object[tmp] = tmp;
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    durable_bst<int, int> recovered{path, options};
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Recovery of " << recovered.size() << " keys (checkpoint and " << n/10 << " log records): "
+              << std::chrono::duration<double, std::milli> (end - begin).count() << " (ms)" << std::endl << std::endl;
+    cleanup();
+
+}
+
+void shardedRun(const unsigned int &n){
+
+    unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+    std::cout << "Hardware threads: " << cores << std::endl;
+
+    //every thread inserts and then looks up its share of random keys
+    auto run = [n](unsigned int threads, auto&& insert, auto&& find){
+        std::vector<std::thread> workers;
+        auto begin = std::chrono::steady_clock::now();
+        for(unsigned int t = 0; t < threads; ++t)
+            workers.emplace_back([&insert, &find, n, threads, t](){
+                std::mt19937 gen(31 + t);
+                std::uniform_int_distribution<> dis(1, 4*n);
+                for(unsigned int k = 0; k < n/threads; ++k)
+                    insert(dis(gen));
+                for(unsigned int k = 0; k < n/threads; ++k)
+                    find(dis(gen));
+            });
+        for(auto& x : workers)
+            x.join();
+        auto end = std::chrono::steady_clock::now();
+        return 2*n / std::chrono::duration<double> (end - begin).count();
+    };
+
+    for(unsigned int threads = 1; threads <= std::max(cores, 4u); threads *= 2){
+        bst<int, int, std::less<int>> single;
+        std::mutex lock;
+        auto locked = run(threads,
+            [&single, &lock](int x){ std::lock_guard<std::mutex> guard{lock}; single.insert(std::make_pair(x, x)); },
+            [&single, &lock](int x){ std::lock_guard<std::mutex> guard{lock}; return single.find(x) != single.end(); });
+
+        sharded_bst<int, int, std::less<int>, 16> sharded;
+        auto parallel = run(threads,
+            [&sharded](int x){ sharded.insert(std::make_pair(x, x)); },
+            [&sharded](int x){ return sharded.contains(x); });
+
+        std::cout << threads << " threads, ops/s with one lock: " << locked << ", with 16 shards: " << parallel << std::endl;
+    }
+    std::cout << std::endl;
+
+}
+
+void cursorRun(const unsigned int &n){
+
+    std::mt19937 gen(37);
+    std::uniform_int_distribution<> dis(1, 2*n);
+    bst<int, int, std::less<int>> object;
+    for(unsigned int k = 0; k < n; ++k){
+        auto tmp = dis(gen);
+        object.insert(std::make_pair(tmp, tmp));
+    }
+
+    long long sum = 0;
+    auto add = [&sum](const std::pair<const int, int>& x){ sum += x.second; };
+
+    for(const auto& x : object) // warm up
+        add(x);
+    sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(const auto& x : object)
+        add(x);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Plain iteration: " << std::chrono::duration<double, std::milli> (end - begin).count() << " (ms)" << std::endl;
+
+    const std::size_t batches[] = {64, 1024};
+    for(auto batch : batches){
+        std::size_t visited = 0, batchCount = 0;
+        auto cursor = object.cursor();
+        begin = std::chrono::steady_clock::now();
+        for(std::size_t got = 1; got > 0; ++batchCount){
+            got = cursor.next(batch, add);
+            visited += got;
+            //a writer between two batches: one erase forces the cursor to seek again
+            auto tmp = dis(gen);
+            object.erase(tmp);
+            object.insert(std::make_pair(tmp + 1, tmp));
+        }
+        end = std::chrono::steady_clock::now();
+        std::cout << "Cursor, batches of " << batch << " (" << batchCount << " batches, " << visited << " pairs): "
+                  << std::chrono::duration<double, std::milli> (end - begin).count() << " (ms)" << std::endl;
+    }
+    std::cout << "Checksum: " << sum << std::endl << std::endl;
+
+}
+
+void intervalRun(const unsigned int &n, const unsigned int &queries){
+
+    //windows of up to 1000 units starting anywhere in [0, 100n)
+    std::mt19937 gen(41);
+    std::uniform_int_distribution<> start(0, 100*n);
+    std::uniform_int_distribution<> length(1, 1000);
+    interval_bst<int, int> object;
+    bst<int, int, std::less<int>> scanned; // start -> end
+    for(unsigned int k = 0; k < n; ++k){
+        auto s = start(gen);
+        auto e = s + length(gen);
+        object.insert(s, e, k);
+        scanned.insert(std::make_pair(s, e));
+    }
+
+    std::size_t found = 0, expected = 0;
+    double tree = 0, scan = 0;
+    for(unsigned int q = 0; q < queries; ++q){
+        auto point = start(gen);
+        auto lo = start(gen);
+        auto hi = lo + 10*length(gen);
+
+        auto begin = std::chrono::steady_clock::now();
+        found += object.query_overlapping(point).size();
+        found += object.query_overlapping(lo, hi).size();
+        auto end = std::chrono::steady_clock::now();
+        tree += std::chrono::duration<double, std::micro> (end - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        for(const auto& x : scanned){
+            expected += (x.first <= point && point < x.second);
+            expected += (x.first < hi && lo < x.second);
+        }
+        end = std::chrono::steady_clock::now();
+        scan += std::chrono::duration<double, std::micro> (end - begin).count();
+    }
+
+    std::cout << "Intervals found: " << found << " (scan: " << expected << ")" << std::endl;
+    std::cout << "Interval tree, average per point and range query pair: " << tree / queries << " (us)" << std::endl;
+    std::cout << "Linear scan, average per point and range query pair: " << scan / queries << " (us)" << std::endl << std::endl;
+
+}
@@ -0,0 +1,277 @@
+#include <bst.hpp>
+#include <map>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Differential harness: an input is a string of bytes decoded as a sequence of operations, which
+// are run on a bst and on a std::map. The results are compared at each step, and after each step
+// the invariants of the tree are checked and its content compared with the map. Cursor scans are
+// interleaved with writes, and the set algebra is checked against the algorithms of <algorithm>.
+// Built with -DBST_LIBFUZZER -fsanitize=fuzzer it is a libFuzzer target, otherwise main generates
+// the inputs from a seed, so that a failure can be reproduced with the same command line.
+
+using tree = bst<int,int,std::less<int>>;
+using reference = std::map<int,int>;
+
+// Bytes of the input, zeros once it is over
+class input {
+    const std::uint8_t* data;
+    std::size_t size;
+    std::size_t position;
+
+    public:
+        input(const std::uint8_t* d, std::size_t n): data{d}, size{n}, position{0} {};
+        std::uint8_t next() { return (position < size) ? data[position++] : 0; }
+        bool empty() const { return position >= size; }
+};
+
+std::size_t operations = 0;
+
+void runInput(const std::uint8_t* data, std::size_t size);
+void step(tree& t, reference& r, input& in, std::size_t n);
+void check(bool condition, std::size_t n, const char* what);
+void compare(const tree& t, const reference& r, std::size_t n);
+void cursorStep(tree& t, reference& r, input& in, std::size_t n, std::size_t batch);
+void algebraStep(tree& t, reference& r, input& in, std::size_t n, int choice);
+
+#ifdef BST_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    runInput(data, size);
+    return 0;
+}
+#else
+int main(int argc, char** argv){
+
+    // ./fuzz [seed] [inputs]
+    unsigned int seed = (argc > 1) ? std::stoul(argv[1]) : 1;
+    unsigned int inputs = (argc > 2) ? std::stoul(argv[2]) : 2000;
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> length(1, 4096);
+    std::uniform_int_distribution<> byte(0, 255);
+    std::vector<std::uint8_t> data;
+    double elapsed = 0;
+
+    for(unsigned int i = 0; i < inputs; ++i){
+        data.resize(length(gen));
+        for(auto& x : data)
+            x = byte(gen);
+        auto begin = std::chrono::steady_clock::now();
+        runInput(data.data(), data.size());
+        auto end = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration<double> (end - begin).count();
+    }
+
+    std::cout << "Seed " << seed << ": " << inputs << " inputs, " << operations << " operations, no mismatch" << std::endl;
+    std::cout << "Operations/s (with the checks): " << operations / elapsed << std::endl;
+    return 0;
+}
+#endif
+
+void runInput(const std::uint8_t* data, std::size_t size){
+    tree t;
+    reference r;
+    input in{data, size};
+    for(std::size_t n = 0; !in.empty(); ++n){
+        step(t, r, in, n);
+        ++operations;
+        check(t.checkInvariants(), n, "broken links or order");
+        compare(t, r, n);
+    }
+}
+
+void check(bool condition, std::size_t n, const char* what){
+    if(!condition){
+        std::cerr << "Operation " << n << ": " << what << std::endl;
+        std::abort();
+    }
+}
+
+void compare(const tree& t, const reference& r, std::size_t n){
+    check(t.size() == r.size(), n, "size differs from std::map");
+    auto x = t.cbegin();
+    for(const auto& y : r){
+        check(x != t.cend() && (*x).first == y.first && (*x).second == y.second, n, "content differs from std::map");
+        ++x;
+    }
+    check(x == t.cend(), n, "more pairs than std::map");
+}
+
+//The keys are a single byte, so that the operations often meet the same keys
+void step(tree& t, reference& r, input& in, std::size_t n){
+    auto op = in.next() % 17;
+    int key = in.next();
+    int value = in.next();
+
+    switch(op){
+    case 0:
+    case 1:
+    case 2: {
+        auto a = t.insert({key, value});
+        auto b = r.insert({key, value});
+        check(a.second == b.second && (*a.first).second == b.first->second, n, "insert");
+        break;
+    }
+    case 3: {
+        auto a = t.emplace(key, value);
+        auto b = r.emplace(key, value);
+        check(a.second == b.second && (*a.first).second == b.first->second, n, "emplace");
+        break;
+    }
+    case 4:
+    case 5:
+        t.erase(key);
+        r.erase(key);
+        break;
+    case 6: {
+        auto a = t.find(key);
+        auto b = r.find(key);
+        check((a == t.end()) == (b == r.end()) && (a == t.end() || (*a).second == b->second), n, "find");
+        break;
+    }
+    case 7: {
+        const tree& c = t;
+        auto a = c.find(key);
+        auto b = r.find(key);
+        check((a == c.end()) == (b == r.end()) && (a == c.end() || (*a).second == b->second), n, "const find");
+        auto l = c.lower_bound(key);
+        auto m = r.lower_bound(key);
+        check((l == c.end()) == (m == r.end()) && (l == c.end() || (*l).first == m->first), n, "lower_bound");
+        auto u = c.upper_bound(key);
+        auto w = r.upper_bound(key);
+        check((u == c.end()) == (w == r.end()) && (u == c.end() || (*u).first == w->first), n, "upper_bound");
+        break;
+    }
+    case 8:
+        if(value & 1)
+            check(t[key] == r[key], n, "operator[] read");
+        else
+            t[key] = r[key] = value;
+        break;
+    case 9:
+        t.balance();
+        break;
+    case 10: {
+        tree copy{t};
+        compare(copy, r, n);
+        if(value & 1)
+            t = copy;
+        else {
+            copy.insert({key, value}); // the copy must not share nodes with t
+            compare(t, r, n);
+        }
+        break;
+    }
+    case 11: {
+        tree moved{std::move(t)};
+        check(t.size() == 0 && t.begin() == t.end(), n, "moved-from tree not empty");
+        t = std::move(moved);
+        if(value & 1) {
+            tree& self = t;
+            t = std::move(self);
+        }
+        break;
+    }
+    case 12:
+        cursorStep(t, r, in, n, 1 + value % 8);
+        break;
+    case 13:
+        t.setIncrementalBalance(value & 1, 0.5 + (value >> 1) / 256.0);
+        break;
+    case 14:
+        t.setSelfAdjusting(value & 1);
+        break;
+    case 15:
+        algebraStep(t, r, in, n, value);
+        break;
+    default:
+        if(value == 0) {
+            t.clear();
+            r.clear();
+        }
+        break;
+    }
+}
+
+//A full scan in batches, with an insert and an erase from the input between two batches (the
+//erase hits the last key returned every other time). Each batch must be what std::map holds
+//after the last key returned by then.
+void cursorStep(tree& t, reference& r, input& in, std::size_t n, std::size_t batch){
+    auto cursor = t.cursor();
+    std::vector<std::pair<int,int>> got;
+    bool started = false;
+    int last = 0;
+    for(;;){
+        auto expected = started ? r.upper_bound(last) : r.begin();
+        got.clear();
+        auto count = cursor.next(batch, [&got](const std::pair<const int,int>& x){ got.emplace_back(x.first, x.second); });
+        check(count == got.size(), n, "cursor count");
+        for(const auto& x : got){
+            check(expected != r.end() && expected->first == x.first && expected->second == x.second, n, "cursor batch differs from std::map");
+            ++expected;
+        }
+        if(count == 0){
+            check(expected == r.end(), n, "cursor stopped early");
+            return;
+        }
+        check(count == batch || expected == r.end(), n, "cursor batch too short");
+        started = true;
+        last = got.back().first;
+
+        int key = in.next();
+        int value = in.next();
+        t.insert({key, value});
+        r.insert({key, value});
+        key = (value & 1) ? last : in.next();
+        t.erase(key);
+        r.erase(key);
+        check(t.checkInvariants(), n, "broken links or order during the scan");
+    }
+}
+
+//A second tree from the input, filled with inserts or with assignSorted, combined with t. The
+//algorithms of <algorithm> copy from the first range the elements found in both, as our functions
+//keep the value of the first tree. The result selected by choice replaces t.
+void algebraStep(tree& t, reference& r, input& in, std::size_t n, int choice){
+    tree other;
+    reference otherMap;
+    unsigned int size = in.next() % 32;
+    for(unsigned int i = 0; i < size; ++i){
+        int key = in.next();
+        otherMap.insert({key, in.next()});
+    }
+    if(choice & 1){
+        std::vector<std::pair<const int,int>> sorted(otherMap.begin(), otherMap.end());
+        other.assignSorted(std::move(sorted));
+    } else
+        for(const auto& x : otherMap)
+            other.insert(x);
+    check(other.checkInvariants(), n, "assignSorted");
+    compare(other, otherMap, n);
+
+    auto byKey = [](const std::pair<const int,int>& a, const std::pair<const int,int>& b){ return a.first < b.first; };
+    reference united, common, remaining;
+    std::set_union(r.begin(), r.end(), otherMap.begin(), otherMap.end(), std::inserter(united, united.end()), byKey);
+    std::set_intersection(r.begin(), r.end(), otherMap.begin(), otherMap.end(), std::inserter(common, common.end()), byKey);
+    std::set_difference(r.begin(), r.end(), otherMap.begin(), otherMap.end(), std::inserter(remaining, remaining.end()), byKey);
+
+    auto a = merge_union(t, other);
+    auto b = intersect(t, other);
+    auto d = difference(t, other);
+    check(a.checkInvariants() && b.checkInvariants() && d.checkInvariants(), n, "broken links or order in set algebra");
+    compare(a, united, n);
+    compare(b, common, n);
+    compare(d, remaining, n);
+
+    switch((choice >> 1) % 4){
+    case 0: t = std::move(a); r = std::move(united); break;
+    case 1: t = std::move(b); r = std::move(common); break;
+    case 2: t = std::move(d); r = std::move(remaining); break;
+    default: break;
+    }
+}
@@ -0,0 +1,255 @@
+#ifndef __async_bst_hpp
+#define __async_bst_hpp
+
+#include <bst.hpp>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+// BST that is compacted in the background while readers and writers go on. The state is made of
+// three layers, looked up from the newest:
+//  - delta: the writes since the last compaction started (a tombstone marks an erased key);
+//  - frozen: the delta being merged by the worker, read-only;
+//  - base: the last compacted tree, balanced and immutable once published.
+// compact() freezes the delta and starts a worker that merges base and frozen into a new balanced
+// tree, without holding any lock. When it is done, the new base is swapped in and frozen dropped
+// under the exclusive lock, which is held for a couple of pointer assignments only. Every lookup
+// sees the three layers under the shared lock, hence a consistent state. A failed merge gives the
+// frozen writes back to delta; if that fails too, frozen stays published until the next compact().
+template <typename k, typename v, typename c = std::less<k> >
+class async_bst {
+    using tree_type = bst<k,v,c>;
+    using delta_type = bst<k, std::pair<bool, v>, c>; // false: the key has been erased
+    using pair_type = std::pair<const k, v>;
+
+    mutable std::shared_timed_mutex lock;
+    c op;
+    std::shared_ptr<const tree_type> base;
+    std::shared_ptr<const delta_type> frozen;
+    delta_type delta;
+    std::size_t count;
+    std::thread worker;
+    std::exception_ptr failure;
+    bool stranded; // frozen is left by a failed compaction that could not give it back to delta
+
+    // private functions
+    const std::pair<bool, v>* findDelta(const k& x) const noexcept;
+    void merge(std::shared_ptr<const tree_type> oldBase, std::shared_ptr<const delta_type> changes);
+    static delta_type emptyDelta(c comp) {
+        delta_type d{comp};
+        d.setIncrementalBalance(true); // writes often come in key order
+        return d;
+    }
+
+    public:
+        async_bst(): async_bst(c()) {};
+        async_bst(c comp): op{comp}, base{std::make_shared<const tree_type>(comp)}, delta{emptyDelta(comp)}, count{0}, stranded{false} {};
+        ~async_bst() { if(worker.joinable()) worker.join(); }
+
+        async_bst(const async_bst&) = delete;
+        async_bst& operator=(const async_bst&) = delete;
+
+        // true and the value in result if the key is present
+        bool find(const k& x, v& result) const;
+        bool contains(const k& x) const;
+
+        // inserts if the key is missing, like bst::insert
+        bool insert(const pair_type& x);
+        // inserts or overwrites, the equivalent of tree[key] = value
+        void assign(const k& key, const v& value);
+        void erase(const k& x);
+
+        std::size_t size() const {
+            std::shared_lock<std::shared_timed_mutex> guard{lock};
+            return count;
+        }
+
+        // Starts a background compaction, false if one is already running. The failure of the
+        // previous one, if wait() did not collect it, is rethrown instead.
+        bool compact();
+        // Waits for the running compaction, rethrowing its exception if it failed
+        void wait();
+        bool compacting() const {
+            std::shared_lock<std::shared_timed_mutex> guard{lock};
+            return frozen != nullptr && !stranded;
+        }
+
+        // The last compacted tree: it can be visited concurrently, but it misses the later writes
+        std::shared_ptr<const tree_type> view() const {
+            std::shared_lock<std::shared_timed_mutex> guard{lock};
+            return base;
+        }
+};
+
+//Looks for x in delta and frozen, the caller holds the lock
+template <typename k, typename v, typename c>
+const std::pair<bool, v>* async_bst<k,v,c>::findDelta(const k& x) const noexcept {
+    auto it = delta.find(x);
+    if(it != delta.cend())
+        return &(*it).second;
+    if(frozen) {
+        it = frozen->find(x);
+        if(it != frozen->cend())
+            return &(*it).second;
+    }
+    return nullptr;
+}
+
+template <typename k, typename v, typename c>
+bool async_bst<k,v,c>::find(const k& x, v& result) const {
+    std::shared_lock<std::shared_timed_mutex> guard{lock};
+    auto d = findDelta(x);
+    if(d != nullptr) {
+        if(d->first)
+            result = d->second;
+        return d->first;
+    }
+    auto it = base->find(x);
+    if(it == base->cend())
+        return false;
+    result = (*it).second;
+    return true;
+}
+
+template <typename k, typename v, typename c>
+bool async_bst<k,v,c>::contains(const k& x) const {
+    std::shared_lock<std::shared_timed_mutex> guard{lock};
+    auto d = findDelta(x);
+    if(d != nullptr)
+        return d->first;
+    return base->find(x) != base->cend();
+}
+
+template <typename k, typename v, typename c>
+bool async_bst<k,v,c>::insert(const pair_type& x) {
+    std::unique_lock<std::shared_timed_mutex> guard{lock};
+    auto d = findDelta(x.first);
+    if((d != nullptr) ? d->first : base->find(x.first) != base->cend())
+        return false;
+    delta[x.first] = std::make_pair(true, x.second);
+    ++count;
+    return true;
+}
+
+template <typename k, typename v, typename c>
+void async_bst<k,v,c>::assign(const k& key, const v& value) {
+    std::unique_lock<std::shared_timed_mutex> guard{lock};
+    auto d = findDelta(key);
+    if(!((d != nullptr) ? d->first : base->find(key) != base->cend()))
+        ++count;
+    delta[key] = std::make_pair(true, value);
+}
+
+template <typename k, typename v, typename c>
+void async_bst<k,v,c>::erase(const k& x) {
+    std::unique_lock<std::shared_timed_mutex> guard{lock};
+    auto d = findDelta(x);
+    if(!((d != nullptr) ? d->first : base->find(x) != base->cend()))
+        return;
+    --count;
+    delta[x] = std::make_pair(false, v{});
+}
+
+//A frozen delta left by a failed compaction is merged again, with the newer writes on top of it
+template <typename k, typename v, typename c>
+bool async_bst<k,v,c>::compact() {
+    std::unique_lock<std::shared_timed_mutex> guard{lock};
+    if(frozen && !stranded)
+        return false;
+    if(worker.joinable())
+        worker.join(); // already done, since frozen is reset (or stranded) at the end of its work
+    if(failure) {
+        auto e = failure;
+        failure = nullptr;
+        std::rethrow_exception(e);
+    }
+    std::shared_ptr<delta_type> changes;
+    if(stranded) {
+        changes = std::make_shared<delta_type>(*frozen);
+        for(auto it = delta.cbegin(); it != delta.cend(); ++it)
+            (*changes)[(*it).first] = (*it).second;
+    } else
+        changes = std::make_shared<delta_type>(std::move(delta));
+    auto kept = std::move(delta); // the writes also in changes when stranded, empty otherwise
+    auto previous = std::move(frozen);
+    delta = emptyDelta(op);
+    frozen = changes;
+    stranded = false;
+    try {
+        worker = std::thread(&async_bst::merge, this, base, frozen);
+    } catch(...) {
+        //no thread: the writes go back where they were, we hold the lock so nothing came after
+        stranded = previous != nullptr;
+        frozen = std::move(previous);
+        delta = stranded ? std::move(kept) : std::move(*changes);
+        throw;
+    }
+    return true;
+}
+
+template <typename k, typename v, typename c>
+void async_bst<k,v,c>::wait() {
+    std::thread done;
+    {
+        std::unique_lock<std::shared_timed_mutex> guard{lock};
+        done = std::move(worker);
+    }
+    if(done.joinable())
+        done.join();
+    std::unique_lock<std::shared_timed_mutex> guard{lock};
+    if(failure) {
+        auto e = failure;
+        failure = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+//Runs on the worker: base and changes are immutable, so no lock is needed to read them. The new
+//tree is built by assignSorted, which allocates the nodes one after the other in pre-order.
+template <typename k, typename v, typename c>
+void async_bst<k,v,c>::merge(std::shared_ptr<const tree_type> oldBase, std::shared_ptr<const delta_type> changes) {
+    try {
+        std::vector<pair_type> values;
+        values.reserve(oldBase->size() + changes->size());
+
+        auto x = oldBase->cbegin();
+        auto y = changes->cbegin();
+        while(x != oldBase->cend() || y != changes->cend()) {
+            if(y == changes->cend() || (x != oldBase->cend() && op((*x).first, (*y).first)))
+                values.push_back(*x++);
+            else {
+                if(x != oldBase->cend() && !op((*y).first, (*x).first))
+                    ++x; // the change overrides the old value
+                if((*y).second.first)
+                    values.emplace_back((*y).first, (*y).second.second);
+                ++y;
+            }
+        }
+
+        auto newBase = std::make_shared<tree_type>(op);
+        newBase->assignSorted(std::move(values));
+
+        std::unique_lock<std::shared_timed_mutex> guard{lock};
+        base = std::move(newBase);
+        frozen.reset();
+    } catch(...) {
+        std::unique_lock<std::shared_timed_mutex> guard{lock};
+        failure = std::current_exception();
+        try {
+            //the frozen writes go back in the delta, unless a newer write has the same key; the
+            //new delta is built aside, so that a failed allocation leaves the old one as it was
+            delta_type restored{*changes};
+            for(auto it = delta.cbegin(); it != delta.cend(); ++it)
+                restored[(*it).first] = (*it).second;
+            delta = std::move(restored);
+            frozen.reset();
+        } catch(...) {
+            //frozen stays published, so that the readers still see its writes
+            stranded = true;
+        }
+    }
+}
+
+#endif
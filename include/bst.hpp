@@ -7,6 +7,9 @@
 #include <utility>
 #include <vector>
 #include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
 
 template <typename T>
 class node {
@@ -20,6 +23,9 @@ class node {
         node(T &&p): value{std::move(p)}, parent{nullptr} {};
         node(const T &p, node* n): value{p}, parent{n} {};
         node(T &&p, node* n): value{std::move(p)}, parent{n} {};
+        // Builds the value in place from the arguments of its constructor
+        template <class... Types>
+        explicit node(node* n, Types&&... args): value(std::forward<Types>(args)...), parent{n} {};
         // Explicit node copy constructor
         explicit node(const std::unique_ptr<node> &p, node* parent): value{p->value}{
             this->parent = parent;
@@ -95,23 +101,66 @@ class _iterator {
         void setCurrent(node_type* x) { current = x;}
 };
 
+// Functions on the links of the nodes, shared by bst and by the trees built on node that cache
+// something about the neighbours of each node (string_bst, interval_bst). The refresh hook is
+// called on a node once its parent and children are in place, and must not throw; noRefresh is
+// the hook of bst, whose nodes cache nothing.
+struct noRefresh {
+    template <typename node_type>
+    void operator()(node_type*) const noexcept {}
+};
+
+template <typename node_type>
+void attachNode(std::unique_ptr<node_type>& head, node_type* parent, bool isLeft, node_type* x) noexcept;
+
+template <typename node_type>
+std::size_t subtreeSize(const node_type* x);
+
+template <typename node_type, typename R>
+void rebuildSubtree(std::unique_ptr<node_type>& head, node_type* x, R refresh);
+
+template <typename node_type, typename R>
+node_type* rebuildRec(std::vector<node_type*>& nodes, std::size_t lo, std::size_t hi, node_type* parent, R& refresh) noexcept;
+
+// Scapegoat step after the insert of x at the given depth in a tree of count nodes: if x is too
+// deep for alpha, rebuilds the subtree of its first ancestor that is no more alpha-weight-balanced
+template <typename node_type, typename R>
+void rebalanceInsert(std::unique_ptr<node_type>& head, node_type* x, std::size_t depth, std::size_t count, double alpha, R refresh);
+
+// Unlinks and deletes x, whose successor (or only child) takes its place. Returns the lowest node
+// whose subtree lost a descendant (nullptr if x was a root with one child at most), for the trees
+// that cache subtree data
+template <typename node_type, typename R>
+node_type* eraseNode(std::unique_ptr<node_type>& head, node_type* x, R refresh);
+
+template <typename k, typename v, typename c>
+class bst_cursor;
+
 template <typename k, typename v, typename c = std::less<k> >
 class bst{
     using node_type = node<std::pair<const k,v> >;
     using pair_type = typename node_type::value_type;
     c op;
     std::unique_ptr<node_type> head;
+    std::size_t count;
+    double alpha; // weight balance factor of the incremental mode, 0 when disabled
+    bool selfAdjusting; // find semi-splays the found node towards the root
+    std::uint64_t version; // changes whenever a node may have been freed, see bst_cursor
 
     // private functions for tree balance
-    void balanceRec(std::vector<pair_type> values, size_t n);
+    node_type* buildRec(std::vector<pair_type>& values, std::size_t lo, std::size_t hi, node_type* parent);
     int height(node_type* x) noexcept {return (x == nullptr) ? 0 : 1 + std::max(height(x->getLeft()), height(x->getRight()));};
     void drawRec(const std::string& prefix, node_type* x, bool isLeft) noexcept;
 
+    // private functions for the self-adjusting mode
+    void rotateUp(node_type* x) noexcept;
+    void semiSplay(node_type* x) noexcept;
+
     public:
-        bst(): op{c()}, head{nullptr} {};
-        bst(c comp): op{comp}, head{nullptr} {};
-        bst(k key, v value): op{c()}, head{ std::make_unique<node_type>(std::pair<k,v>(key,value))} {};
-        bst(k key, v value, c comp): op{comp}, head{ std::make_unique<node_type>(std::pair<k,v>(key,value))} {};
+        bst(): op{c()}, head{nullptr}, count{0}, alpha{0}, selfAdjusting{false}, version{0} {};
+        bst(c comp): op{comp}, head{nullptr}, count{0}, alpha{0}, selfAdjusting{false}, version{0} {};
+        bst(k key, v value): op{c()}, head{ std::make_unique<node_type>(std::pair<k,v>(key,value))}, count{1}, alpha{0}, selfAdjusting{false}, version{0} {};
+        bst(k key, v value, c comp): op{comp}, head{ std::make_unique<node_type>(std::pair<k,v>(key,value))}, count{1}, alpha{0}, selfAdjusting{false}, version{0} {};
         
         using iterator = _iterator<node_type, pair_type>;
         using const_iterator = _iterator<node_type, const pair_type>;
@@ -122,7 +171,15 @@ class bst{
         template<class... Types>
         std::pair<iterator,bool> emplace(Types&&... args) {return insert(pair_type(std::forward<Types>(args)...));}; 
 
-        void clear() noexcept { if(head) {head.reset();} }; 
+        void clear() noexcept { if(head) {head.reset();} count = 0; ++version; }; 
+
+        std::size_t size() const noexcept { return count; }
+
+        c key_comp() const { return op; }
+
+        // Replaces the content with values, which must be sorted by the comparator and without
+        // duplicated keys: the balanced tree is built in linear time, with no comparison.
+        void assignSorted(std::vector<pair_type>&& values);
 
         iterator begin() noexcept;
         const_iterator begin() const noexcept;
@@ -135,9 +192,25 @@ class bst{
         iterator find(const k& x) noexcept; 
         const_iterator find(const k& x) const noexcept; 
 
+        // first pair whose key is not less than x, and first pair whose key is greater than x
+        const_iterator lower_bound(const k& x) const noexcept;
+        const_iterator upper_bound(const k& x) const noexcept;
+
+        // Resumable in-order scan, that survives the modifications of the tree between two batches
+        bst_cursor<k,v,c> cursor() const noexcept { return bst_cursor<k,v,c>{this}; }
+        std::uint64_t getVersion() const noexcept { return version; }
+
         void balance(); 
+        // Scapegoat mode: when a new node is deeper than log(n)/log(1/alpha), insert rebuilds
+        // only the subtree of its first ancestor that is no more alpha-weight-balanced
+        void setIncrementalBalance(bool on, double a = 0.7);
+        // Semi-splay mode: the non-const find moves the found node towards the root, so that
+        // the keys accessed more often stay near the top. Iterators are not invalidated.
+        void setSelfAdjusting(bool on) noexcept { selfAdjusting = on; }
         //This function has been used to debug the balance function.
         bool isBalanced(node_type* x) noexcept; 
+        // Checks the links and the order of the whole tree, used by the fuzz harness
+        bool checkInvariants() const;
 
         v& operator[](const k& x) {
             auto it = find(x);
@@ -172,22 +245,83 @@ class bst{
         void draw() {drawRec("",head.get(),false);};
 
         // copy semantic
-        bst(const bst &b): op{b.op} { head = std::make_unique<node_type>(b.head,nullptr); } // copy constr
+        bst(const bst &b): op{b.op}, count{b.count}, alpha{b.alpha}, selfAdjusting{b.selfAdjusting}, version{0} { // copy constr
+            if(b.head)
+                head = std::make_unique<node_type>(b.head,nullptr);
+        }
         
         bst& operator=(const bst& b){ // copy assignment
+            if(this == &b)
+                return *this;
             this->clear();
             op = b.op;
-            head = std::make_unique<node_type>(b.head,nullptr);
+            if(b.head)
+                head = std::make_unique<node_type>(b.head,nullptr);
+            count = b.count;
+            alpha = b.alpha;
+            selfAdjusting = b.selfAdjusting;
             return *this;
         } 
 
         // move semantic
-        bst(bst&& b) noexcept = default; // move constr 
-        bst& operator=(bst&& b) noexcept = default; //move assignment
+        bst(bst&& b) noexcept: op{std::move(b.op)}, head{std::move(b.head)}, count{b.count}, alpha{b.alpha}, selfAdjusting{b.selfAdjusting}, version{0} { // move constr
+            b.count = 0;
+            ++b.version;
+        }
+        bst& operator=(bst&& b) noexcept { //move assignment
+            if(this != &b) {
+                op = std::move(b.op);
+                head = std::move(b.head);
+                count = b.count;
+                alpha = b.alpha;
+                selfAdjusting = b.selfAdjusting;
+                b.count = 0;
+                ++version;
+                ++b.version;
+            }
+            return *this;
+        }
 
         void erase(const k& x);
 };
 
+// Resumable in-order scan. It remembers the last key returned and the version of the tree at that
+// moment: if no node has been freed since, the scan goes on from the last node, otherwise it seeks
+// the next key with upper_bound in O(log n). The tree can be modified between two calls of next,
+// for instance by the writers that take the lock between two batches of an export, but neither
+// during a call nor by f. The keys inserted after the last one returned will be visited.
+template <typename k, typename v, typename c>
+class bst_cursor {
+    using tree_type = bst<k,v,c>;
+    using const_iterator = typename tree_type::const_iterator;
+
+    const tree_type* tree;
+    const_iterator position; // last pair returned
+    std::unique_ptr<k> last; // its key, nullptr before the first pair
+    std::uint64_t version;
+
+    public:
+        explicit bst_cursor(const tree_type* t) noexcept: tree{t}, position{}, last{nullptr}, version{0} {};
+
+        // Calls f on the next n pairs at most, and returns how many they were: 0 at the end
+        template <class F>
+        std::size_t next(std::size_t n, F&& f);
+
+        bool started() const noexcept { return last != nullptr; }
+};
+
+// Set algebra on the keys. The two trees are visited in order at the same time and the result is
+// built with assignSorted, so the cost is O(n + m) instead of a find and an insert per element.
+// When a key is in both trees, the value of a is kept.
+template <typename k, typename v, typename c>
+bst<k,v,c> merge_union(const bst<k,v,c>& a, const bst<k,v,c>& b);
+
+template <typename k, typename v, typename c>
+bst<k,v,c> intersect(const bst<k,v,c>& a, const bst<k,v,c>& b);
+
+template <typename k, typename v, typename c>
+bst<k,v,c> difference(const bst<k,v,c>& a, const bst<k,v,c>& b);
+
 
 ////////////////////////////////
 /////                     //////
@@ -214,6 +348,168 @@ node_type* _iterator<node_type,T>::next() noexcept {
     return current;
 }
 
+/////////////////////////////
+/////                  //////
+/////  NODE FUNCTIONS  //////
+/////                  //////
+/////////////////////////////
+
+template <typename node_type>
+void attachNode(std::unique_ptr<node_type>& head, node_type* parent, bool isLeft, node_type* x) noexcept {
+    if(parent == nullptr)
+        head.reset(x);
+    else if(isLeft)
+        parent->setLeft(x);
+    else
+        parent->setRight(x);
+    if(x != nullptr)
+        x->setParent(parent);
+}
+
+template <typename node_type>
+std::size_t subtreeSize(const node_type* x) {
+    std::size_t n = 0;
+    std::vector<const node_type*> stack;
+    if(x != nullptr)
+        stack.push_back(x);
+    while(!stack.empty()) {
+        auto tmp = stack.back();
+        stack.pop_back();
+        ++n;
+        if(tmp->getLeft())
+            stack.push_back(tmp->getLeft());
+        if(tmp->getRight())
+            stack.push_back(tmp->getRight());
+    }
+    return n;
+}
+
+//Re-links the nodes of the subtree rooted in x in a perfectly balanced shape, without
+//allocating new nodes: the middle element of the in-order sequence becomes the root.
+template <typename node_type, typename R>
+void rebuildSubtree(std::unique_ptr<node_type>& head, node_type* x, R refresh) {
+
+    //collecting the nodes in order, the stack avoids recursion on degenerate trees
+    std::vector<node_type*> nodes;
+    std::vector<node_type*> stack;
+    auto tmp = x;
+    while(tmp != nullptr || !stack.empty()) {
+        while(tmp != nullptr) {
+            stack.push_back(tmp);
+            tmp = tmp->getLeft();
+        }
+        tmp = stack.back();
+        stack.pop_back();
+        nodes.push_back(tmp);
+        tmp = tmp->getRight();
+    }
+
+    //detaching the subtree: from now on nobody owns its nodes
+    auto parent = x->getParent();
+    bool isLeft = parent != nullptr && parent->getLeft() == x;
+    if(parent == nullptr)
+        head.release();
+    else if(isLeft)
+        parent->releaseLeft();
+    else
+        parent->releaseRight();
+    for(auto n : nodes) {
+        n->releaseLeft();
+        n->releaseRight();
+    }
+
+    //the subtree keeps the same nodes, so what the ancestors cache about it does not change
+    attachNode(head, parent, isLeft, rebuildRec(nodes, 0, nodes.size(), parent, refresh));
+}
+
+template <typename node_type, typename R>
+node_type* rebuildRec(std::vector<node_type*>& nodes, std::size_t lo, std::size_t hi, node_type* parent, R& refresh) noexcept {
+    if(lo == hi)
+        return nullptr;
+
+    auto middle = lo + (hi - lo - 1)/2; //same shape of the former balanceRec
+    auto x = nodes[middle];
+    x->setParent(parent);
+    x->setLeft(rebuildRec(nodes, lo, middle, x, refresh));
+    x->setRight(rebuildRec(nodes, middle + 1, hi, x, refresh));
+    refresh(x);
+    return x;
+}
+
+//If the tree is too deep, we go up looking for the first ancestor whose child is heavier than
+//alpha times its own size (the scapegoat) and we rebuild only its subtree. alpha 0 disables it.
+template <typename node_type, typename R>
+void rebalanceInsert(std::unique_ptr<node_type>& head, node_type* x, std::size_t depth, std::size_t count, double alpha, R refresh) {
+    if(alpha == 0 || depth <= std::floor(std::log(count)/std::log(1/alpha)))
+        return;
+
+    std::size_t size = 1;
+    auto parent = x->getParent();
+    while(parent != nullptr) {
+        auto sibling = (parent->getLeft() == x) ? parent->getRight() : parent->getLeft();
+        auto parentSize = size + 1 + subtreeSize(sibling);
+        if(size > alpha*parentSize) {
+            rebuildSubtree(head, parent, refresh);
+            return;
+        }
+        x = parent;
+        size = parentSize;
+        parent = x->getParent();
+    }
+}
+
+//The node is detached with its children, then the successor (or the only child) takes its place.
+//refresh is called on the nodes that change parent, children first.
+template <typename node_type, typename R>
+node_type* eraseNode(std::unique_ptr<node_type>& head, node_type* x, R refresh) {
+
+    auto parent = x->getParent();
+    bool isLeft = parent != nullptr && parent->getLeft() == x;
+    if(parent == nullptr)
+        head.release();
+    else if(isLeft)
+        parent->releaseLeft();
+    else
+        parent->releaseRight();
+    std::unique_ptr<node_type> del{x};
+
+    auto left = x->releaseLeft();
+    auto right = x->releaseRight();
+    node_type* next;
+    node_type* lowest = parent;
+
+    if(left == nullptr)
+        next = right;
+    else if(right == nullptr)
+        next = left;
+    else {
+        next = right;
+        while(next->getLeft() != nullptr)
+            next = next->getLeft();
+        if(next != right) {
+            auto nextParent = next->getParent();
+            nextParent->releaseLeft();
+            auto moved = next->releaseRight();
+            attachNode(head, nextParent, true, moved);
+            if(moved != nullptr)
+                refresh(moved);
+            next->setRight(right);
+            right->setParent(next);
+            refresh(right);
+            lowest = nextParent;
+        } else
+            lowest = next;
+        next->setLeft(left);
+        left->setParent(next);
+        refresh(left);
+    }
+
+    attachNode(head, parent, isLeft, next);
+    if(next != nullptr)
+        refresh(next);
+    return lowest;
+}
+
 ///////////////////////////
 /////                //////
 /////  BST FUNCTIONS //////
@@ -265,14 +561,17 @@ std::pair<typename bst<k,v,c>::iterator,bool> bst<k,v,c>::insert(const pair_type
 
     if (head == nullptr){
         head = std::make_unique<node_type>(x, nullptr);;
+        count = 1;
         return(std::make_pair(iterator(head.get()),true));
     }
     
     node_type* new_node = nullptr;  
     auto tmp = head.get();
+    std::size_t depth = 0;
     
     while (tmp != nullptr){
         new_node = tmp;
+        ++depth;
         if (op(x.first,tmp->getValue().first))
             tmp = tmp->getLeft();
         else if (op(tmp->getValue().first, x.first))
@@ -287,6 +586,8 @@ std::pair<typename bst<k,v,c>::iterator,bool> bst<k,v,c>::insert(const pair_type
     else
         new_node->setRight(tmp); 
      
+    ++count;
+    rebalanceInsert(head, tmp, depth, count, alpha, noRefresh{});
     return(std::make_pair(iterator(tmp),true)); 
 }
 
@@ -295,14 +596,17 @@ std::pair<typename bst<k,v,c>::iterator,bool> bst<k,v,c>::insert(pair_type&& x){
     
     if (head == nullptr){
         head = std::make_unique<node_type>(std::move(x), nullptr);
+        count = 1;
         return(std::make_pair(iterator(head.get()),true));
     }
     
     node_type* new_node = nullptr;  
     auto tmp = head.get() ;
+    std::size_t depth = 0;
     
     while (tmp != nullptr){
         new_node = tmp;
+        ++depth;
         if (op(x.first,tmp->getValue().first))
             tmp = tmp->getLeft();
         else if (op(tmp->getValue().first,x.first))
@@ -315,6 +619,8 @@ std::pair<typename bst<k,v,c>::iterator,bool> bst<k,v,c>::insert(pair_type&& x){
         new_node->setLeft(tmp); 
     else
         new_node->setRight(tmp);
+    ++count;
+    rebalanceInsert(head, tmp, depth, count, alpha, noRefresh{});
     return(std::make_pair(iterator(tmp),true)); 
 }
 
@@ -328,8 +634,11 @@ typename bst<k,v,c>::iterator bst<k,v,c>::find(const k& x) noexcept{
             it.setCurrent(node->getRight()); 
         else if(op(x,node->getValue().first))
             it.setCurrent(node->getLeft()); 
-        else
+        else {
+            if(selfAdjusting)
+                semiSplay(node);
             return(iterator(it)); 
+        }
     }
     return end();
 }
@@ -350,155 +659,148 @@ typename bst<k,v,c>::const_iterator bst<k,v,c>::find(const k& x) const noexcept{
     return cend();
 }
 
+//Usual descent, remembering the last node where we turned left: it is the smallest key of the
+//tree not less than (or greater than) x.
+template <typename k, typename v, typename c>
+typename bst<k,v,c>::const_iterator bst<k,v,c>::lower_bound(const k& x) const noexcept{
+
+    node_type* candidate = nullptr;
+    auto node = head.get();
+    while(node != nullptr){
+        if(op(node->getValue().first,x))
+            node = node->getRight();
+        else {
+            candidate = node;
+            node = node->getLeft();
+        }
+    }
+    return const_iterator(candidate);
+}
+
+template <typename k, typename v, typename c>
+typename bst<k,v,c>::const_iterator bst<k,v,c>::upper_bound(const k& x) const noexcept{
+
+    node_type* candidate = nullptr;
+    auto node = head.get();
+    while(node != nullptr){
+        if(op(x,node->getValue().first)) {
+            candidate = node;
+            node = node->getLeft();
+        } else
+            node = node->getRight();
+    }
+    return const_iterator(candidate);
+}
+
+//The successor (or the only child) takes the place of the node, see eraseNode
 template <typename k, typename v, typename c>
 void bst<k,v,c>::erase(const k& x){
 
     iterator p = find(x);
 
     if (p != end()){
-        auto current = p.getCurrent();
-        auto left = current->getLeft();
-        auto right = current->getRight();
-        auto parent = current->getParent();
-           
-        if(left && right) { // node with two children
-            ++p;
-            auto _current = p.getCurrent();
-            auto _parent = _current->getParent();
-            auto _right = _current->getRight();
-            auto tmp = current->releaseLeft();
-            _current->setLeft(tmp);
-            tmp->setParent(_current);
-
-            if(_parent == current) {
-                auto tmp_next = _parent->releaseRight();
-                if(head.get() == current) { 
-                    auto del_root = head.release();
-                    head.reset(tmp_next);
-                    delete del_root;
-                } else if(parent->getLeft() == current) {
-                    auto tmp_current = parent->releaseLeft();
-                    parent->setLeft(tmp_next);
-                    delete tmp_current;
-                } else {
-                    auto tmp_current = parent->releaseRight();
-                    parent->setRight(tmp_next);
-                    delete tmp_current;
-                }
-                tmp_next->setParent(parent);
-            } else {
-                auto tmp_next = _parent->releaseLeft();
-                if(_right) {
-                    auto tmp_right = _current->releaseRight();
-                    _parent->setLeft(tmp_right);
-                    tmp_right->setParent(_parent);
-                }
-
-                auto tmp_parent = current->releaseRight();
-                tmp_next->setRight(tmp_parent);
-                tmp_parent->setParent(tmp_next);
-                
-                if(head.get() == current) {
-                    auto del_root = head.release();
-                    head.reset(tmp_next);
-                    delete del_root;
-                } else if (parent->getLeft() == current) {
-                    auto tmp_current = parent->releaseLeft();
-                    parent->setLeft(tmp_next);
-                    delete tmp_current;
-                } else {
-                    auto tmp_current = parent->releaseRight();
-                    parent->setRight(tmp_next);
-                    delete tmp_current;    
-                }
-                tmp_next->setParent(parent);  
-            }
-        } else if(!left && !right) { // leaf node  
-             
-            if(head.get() == current) {
-                auto del_root = head.release();
-                head.reset(nullptr);
-                delete del_root;
-            }
-            else if(parent->getLeft() == current)
-                parent->setLeft(nullptr);
-            else
-                parent->setRight(nullptr);
-        } else if(left && !right) { // node with only left child
-            
-            left->setParent(parent);
-            if(head.get() == current) {
-                auto new_root = current->releaseLeft();
-                auto del_root = head.release();
-                head.reset(new_root);
-                delete del_root;
-            } else if(parent->getLeft() == current) {
-                auto tmp = parent->releaseLeft();
-                tmp->releaseLeft();
-                parent->setLeft(left);  
-                delete tmp;
-            } else {
-                auto tmp = parent->releaseRight();
-                tmp->releaseLeft();
-                parent->setRight(left);
-                delete tmp;
-            }      
-        } else { // node with only right child 
-            right->setParent(parent);
-            if(head.get() == current) {
-                auto new_root = current->releaseRight();
-                auto del_root = head.release();
-                head.reset(new_root);
-                delete del_root;
-            } else if(parent->getLeft() == current) {
-                auto tmp = parent->releaseLeft();
-                tmp->releaseRight();
-                parent->setLeft(right);
-                delete tmp;
-            } else {
-                auto tmp = parent->releaseRight();
-                parent->setRight(right);
-                tmp->releaseRight(); 
-                delete tmp;
-            }
-        }
+        eraseNode(head, p.getCurrent(), noRefresh{});
+
+        //erase never makes the tree deeper: unlike the textbook scapegoat we do not rebuild
+        //the whole tree when it shrinks, the height stays within the bound of the largest size
+        --count;
+        ++version;
     }
 }
 
 template <typename k, typename v, typename c>
 void bst<k,v,c>::balance() {
+    if(head)
+        rebuildSubtree(head, head.get(), noRefresh{});
+}
+
+template <typename k, typename v, typename c>
+void bst<k,v,c>::assignSorted(std::vector<pair_type>&& values) {
+    clear();
+    head.reset(buildRec(values, 0, values.size(), nullptr));
+    count = values.size();
+}
+
+//Same shape of rebuildRec, but the nodes are allocated from the values. Each node is owned by
+//a unique pointer until it is returned, so nothing leaks if an allocation throws.
+template <typename k, typename v, typename c>
+typename bst<k,v,c>::node_type* bst<k,v,c>::buildRec(std::vector<pair_type>& values, std::size_t lo, std::size_t hi, node_type* parent) {
+    if(lo == hi)
+        return nullptr;
+
+    auto middle = lo + (hi - lo - 1)/2;
+    auto x = std::make_unique<node_type>(std::move(values[middle]), parent);
+    x->setLeft(buildRec(values, lo, middle, x.get()));
+    x->setRight(buildRec(values, middle + 1, hi, x.get()));
+    return x.release();
+}
+
+template <typename k, typename v, typename c>
+void bst<k,v,c>::setIncrementalBalance(bool on, double a) {
+    if(on && (a < 0.5 || a >= 1))
+        throw std::invalid_argument("bst: alpha must be in [0.5, 1)");
+    alpha = on ? a : 0;
+    if(on)
+        balance(); // the height bound holds from now on
+}
 
-    //copying ordered values in a vector 
-    std::vector<pair_type> values;
-    auto it = cbegin();
-    while(it != cend()){
-        values.push_back((*it));
-        it++;
+//Rotates x above its parent: the subtree between them changes side and the parent becomes
+//a child of x. Only the links are moved, unique pointers are released before being reassigned.
+template <typename k, typename v, typename c>
+void bst<k,v,c>::rotateUp(node_type* x) noexcept {
+    auto parent = x->getParent();
+    auto grand = parent->getParent();
+    bool parentIsLeft = grand != nullptr && grand->getLeft() == parent;
+
+    if(grand == nullptr)
+        head.release();
+    else if(parentIsLeft)
+        grand->releaseLeft();
+    else
+        grand->releaseRight();
+
+    if(parent->getLeft() == x) {
+        parent->releaseLeft();
+        auto middle = x->releaseRight();
+        parent->setLeft(middle);
+        if(middle)
+            middle->setParent(parent);
+        x->setRight(parent);
+    } else {
+        parent->releaseRight();
+        auto middle = x->releaseLeft();
+        parent->setRight(middle);
+        if(middle)
+            middle->setParent(parent);
+        x->setLeft(parent);
     }
-    clear(); //clear the bst
-    balanceRec(values, values.size()); //re-built the balanced bst
+    parent->setParent(x);
+
+    x->setParent(grand);
+    if(grand == nullptr)
+        head.reset(x);
+    else if(parentIsLeft)
+        grand->setLeft(x);
+    else
+        grand->setRight(x);
 }
 
+//Bottom-up semi-splay: like splaying, but in the zig-zig case only the parent is rotated and
+//we carry on from it. The path to x is roughly halved with about half of the rotations.
 template <typename k, typename v, typename c>
-void bst<k,v,c>::balanceRec(std::vector<pair_type> values, size_t n) {
-    if(n==1) {
-        insert({values.at(0).first,values.at(0).second});
-    } else if(n==2) {
-        insert({values.at(0).first,values.at(0).second});
-        insert({values.at(1).first,values.at(1).second});
-    } else{
-        int middle = (n % 2 == 0) ? (n/2)-1 : floor(n/2);
-        insert({values.at(middle).first,values.at(middle).second});
-
-        //create 2 sub-vectors
-        auto firstLeft = values.begin();
-        auto lastLeft = values.begin() + middle;
-        auto firstRight = values.begin() + middle + 1;
-        auto lastRight = values.end();
-        std::vector<pair_type> leftValues(firstLeft,lastLeft);
-        std::vector<pair_type> rightValues(firstRight,lastRight);
-        balanceRec(leftValues, leftValues.size());
-        balanceRec(rightValues, rightValues.size());
+void bst<k,v,c>::semiSplay(node_type* x) noexcept {
+    while(x->getParent() != nullptr) {
+        auto parent = x->getParent();
+        auto grand = parent->getParent();
+        if(grand == nullptr) { // zig
+            rotateUp(x);
+        } else if((grand->getLeft() == parent) == (parent->getLeft() == x)) { // zig-zig
+            rotateUp(parent);
+            x = parent;
+        } else { // zig-zag
+            rotateUp(x);
+            rotateUp(x);
+        }
     }
 }
 
@@ -515,6 +817,136 @@ bool bst<k,v,c>::isBalanced(node_type* x) noexcept {
     return false;
 }
 
+//Visits the tree from head following the children only, so that a wrong parent link cannot make
+//it loop: every key must lie between the keys of the ancestors where the path turned, every child
+//must point back to its parent, and the nodes must be count. The iterator, which follows the
+//parents, must then visit the same number of nodes.
+template <typename k, typename v, typename c>
+bool bst<k,v,c>::checkInvariants() const {
+    struct frame {
+        node_type* x;
+        node_type* lo; // the key of x must be greater than the key of lo, if any
+        node_type* hi; // and less than the key of hi
+    };
+    if(head && head->getParent() != nullptr)
+        return false;
+
+    std::size_t nodes = 0;
+    std::vector<frame> stack;
+    if(head)
+        stack.push_back(frame{head.get(), nullptr, nullptr});
+    while(!stack.empty()) {
+        auto f = stack.back();
+        stack.pop_back();
+        const auto& key = f.x->getValue().first;
+        if((f.lo && !op(f.lo->getValue().first, key)) || (f.hi && !op(key, f.hi->getValue().first)))
+            return false;
+        if(++nodes > count)
+            return false;
+        if(auto l = f.x->getLeft()) {
+            if(l->getParent() != f.x)
+                return false;
+            stack.push_back(frame{l, f.lo, f.x});
+        }
+        if(auto r = f.x->getRight()) {
+            if(r->getParent() != f.x)
+                return false;
+            stack.push_back(frame{r, f.x, f.hi});
+        }
+    }
+    if(nodes != count)
+        return false;
+
+    std::size_t visited = 0;
+    for(auto it = cbegin(); it != cend(); ++it)
+        ++visited;
+    return visited == count;
+}
+
+/////////////////////////////////
+/////                      //////
+/////  SET ALGEBRA         //////
+/////                      //////
+/////////////////////////////////
+
+template <typename k, typename v, typename c>
+bst<k,v,c> merge_union(const bst<k,v,c>& a, const bst<k,v,c>& b) {
+    auto op = a.key_comp();
+    std::vector<std::pair<const k,v>> values;
+    values.reserve(a.size() + b.size());
+
+    auto x = a.cbegin();
+    auto y = b.cbegin();
+    while(x != a.cend() && y != b.cend()) {
+        if(op((*x).first, (*y).first))
+            values.push_back(*x++);
+        else if(op((*y).first, (*x).first))
+            values.push_back(*y++);
+        else {
+            values.push_back(*x++);
+            ++y;
+        }
+    }
+    for(; x != a.cend(); ++x)
+        values.push_back(*x);
+    for(; y != b.cend(); ++y)
+        values.push_back(*y);
+
+    bst<k,v,c> result{op};
+    result.assignSorted(std::move(values));
+    return result;
+}
+
+template <typename k, typename v, typename c>
+bst<k,v,c> intersect(const bst<k,v,c>& a, const bst<k,v,c>& b) {
+    auto op = a.key_comp();
+    std::vector<std::pair<const k,v>> values;
+    values.reserve(std::min(a.size(), b.size()));
+
+    auto x = a.cbegin();
+    auto y = b.cbegin();
+    while(x != a.cend() && y != b.cend()) {
+        if(op((*x).first, (*y).first))
+            ++x;
+        else if(op((*y).first, (*x).first))
+            ++y;
+        else {
+            values.push_back(*x++);
+            ++y;
+        }
+    }
+
+    bst<k,v,c> result{op};
+    result.assignSorted(std::move(values));
+    return result;
+}
+
+template <typename k, typename v, typename c>
+bst<k,v,c> difference(const bst<k,v,c>& a, const bst<k,v,c>& b) {
+    auto op = a.key_comp();
+    std::vector<std::pair<const k,v>> values;
+    values.reserve(a.size());
+
+    auto x = a.cbegin();
+    auto y = b.cbegin();
+    while(x != a.cend() && y != b.cend()) {
+        if(op((*x).first, (*y).first))
+            values.push_back(*x++);
+        else if(op((*y).first, (*x).first))
+            ++y;
+        else {
+            ++x;
+            ++y;
+        }
+    }
+    for(; x != a.cend(); ++x)
+        values.push_back(*x);
+
+    bst<k,v,c> result{op};
+    result.assignSorted(std::move(values));
+    return result;
+}
+
 template <typename k, typename v, typename c>
 void bst<k,v,c>::drawRec(const std::string& prefix, node_type* x, bool isLeft) noexcept {
     if(x != nullptr){
@@ -531,4 +963,39 @@ void bst<k,v,c>::drawRec(const std::string& prefix, node_type* x, bool isLeft) n
     }
 }
 
+//////////////////////////////
+/////                   //////
+/////  CURSOR FUNCTIONS //////
+/////                   //////
+//////////////////////////////
+
+//The key is copied once per batch, not once per pair. An empty batch keeps the old version, so
+//that a stale position is never used.
+template <typename k, typename v, typename c>
+template <class F>
+std::size_t bst_cursor<k,v,c>::next(std::size_t n, F&& f) {
+    const_iterator it;
+    if(last == nullptr)
+        it = tree->cbegin();
+    else if(version == tree->getVersion())
+        it = std::next(position);
+    else
+        it = tree->upper_bound(*last);
+
+    std::size_t i = 0;
+    for(; i < n && it != tree->cend(); ++i) {
+        position = it;
+        f(*it);
+        ++it;
+    }
+    if(i > 0) {
+        if(last)
+            *last = (*position).first;
+        else
+            last = std::make_unique<k>((*position).first);
+        version = tree->getVersion();
+    }
+    return i;
+}
+
 #endif
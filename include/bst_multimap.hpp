@@ -0,0 +1,297 @@
+#ifndef __bst_multimap_hpp
+#define __bst_multimap_hpp
+
+#include <bst.hpp>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+// Vector with small buffer optimisation: the first N elements live inside the object, and only a
+// longer list goes on the heap. Length and capacity are 32-bit, so with two int values the whole
+// list takes 16 bytes.
+template <typename T, std::size_t N>
+class small_list {
+    static_assert(N > 0, "small_list: the inline buffer needs at least one element");
+    using storage_type = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    std::uint32_t length;
+    std::uint32_t capacity;
+    union {
+        T* heap;
+        storage_type buffer[N];
+    };
+
+    // private functions
+    bool isInline() const noexcept { return capacity == N; }
+    void grow();
+    void release() noexcept;
+    void steal(small_list& l) noexcept(std::is_nothrow_move_constructible<T>::value);
+
+    public:
+        small_list() noexcept: length{0}, capacity{N} {};
+        ~small_list() { release(); }
+
+        small_list(const small_list& l): length{0}, capacity{N} {
+            for(const auto& x : l)
+                push_back(x);
+        }
+
+        small_list(small_list&& l) noexcept(std::is_nothrow_move_constructible<T>::value): length{0}, capacity{N} {
+            steal(l);
+        }
+
+        small_list& operator=(const small_list& l) {
+            if(this != &l) {
+                small_list tmp{l};
+                *this = std::move(tmp);
+            }
+            return *this;
+        }
+
+        small_list& operator=(small_list&& l) noexcept(std::is_nothrow_move_constructible<T>::value) {
+            if(this != &l) {
+                release();
+                steal(l);
+            }
+            return *this;
+        }
+
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        T* begin() noexcept { return isInline() ? reinterpret_cast<T*>(buffer) : heap; }
+        const T* begin() const noexcept { return isInline() ? reinterpret_cast<const T*>(buffer) : heap; }
+        T* end() noexcept { return begin() + length; }
+        const T* end() const noexcept { return begin() + length; }
+
+        T& operator[](std::size_t i) noexcept { return begin()[i]; }
+        const T& operator[](std::size_t i) const noexcept { return begin()[i]; }
+
+        std::size_t size() const noexcept { return length; }
+        bool empty() const noexcept { return length == 0; }
+
+        template<class... Types>
+        T& emplace_back(Types&&... args) {
+            if(length == capacity)
+                grow();
+            auto x = new (end()) T(std::forward<Types>(args)...);
+            ++length;
+            return *x;
+        }
+
+        void push_back(const T& x) { emplace_back(x); }
+        void push_back(T&& x) { emplace_back(std::move(x)); }
+
+        void clear() noexcept {
+            for(auto& x : *this)
+                x.~T();
+            length = 0;
+        }
+};
+
+//Doubles the capacity moving the elements in a new heap block. Only the inline buffer is never freed.
+template <typename T, std::size_t N>
+void small_list<T,N>::grow() {
+    auto newCapacity = 2*static_cast<std::size_t>(capacity);
+    if(newCapacity > UINT32_MAX)
+        throw std::length_error("small_list: too many elements");
+    auto block = static_cast<T*>(::operator new(newCapacity*sizeof(T)));
+    std::uint32_t i = 0;
+    try {
+        for(; i < length; ++i)
+            new (block + i) T(std::move_if_noexcept(begin()[i]));
+    } catch(...) {
+        for(std::uint32_t j = 0; j < i; ++j)
+            block[j].~T();
+        ::operator delete(block);
+        throw;
+    }
+    auto n = length;
+    release();
+    heap = block;
+    length = n;
+    capacity = static_cast<std::uint32_t>(newCapacity);
+}
+
+template <typename T, std::size_t N>
+void small_list<T,N>::release() noexcept {
+    clear();
+    if(!isInline())
+        ::operator delete(heap);
+    capacity = N;
+}
+
+//Moves the content of l into this empty list: a heap block changes owner, while the inline
+//elements have to be moved one by one. l is left empty.
+template <typename T, std::size_t N>
+void small_list<T,N>::steal(small_list& l) noexcept(std::is_nothrow_move_constructible<T>::value) {
+    if(l.isInline()) {
+        for(auto& x : l) {
+            new (end()) T(std::move(x));
+            ++length;
+        }
+        l.release();
+    } else {
+        heap = l.heap;
+        length = l.length;
+        capacity = l.capacity;
+        l.length = 0;
+        l.capacity = N;
+    }
+}
+
+template <typename tree_iterator, typename K, typename V>
+class _multimap_iterator {
+    tree_iterator current;
+    std::size_t index; // position in the list of values of the current key
+
+    public:
+        _multimap_iterator() noexcept: current{}, index{0} {};
+        _multimap_iterator(tree_iterator x, std::size_t i) noexcept: current{x}, index{i} {};
+
+        using value_type = std::pair<const K, V>;
+        using reference = std::pair<const K&, V&>;
+        struct pointer {
+            reference ref;
+            reference* operator->() noexcept { return &ref; }
+        };
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        reference operator*() const noexcept { return reference{(*current).first, (*current).second[index]}; }
+
+        pointer operator->() const noexcept { return pointer{*(*this)}; }
+
+        _multimap_iterator& operator++() noexcept {  // pre increment
+            if(++index == (*current).second.size()) {
+                ++current;
+                index = 0;
+            }
+            return *this;
+        }
+
+        _multimap_iterator operator++(int) noexcept {
+            _multimap_iterator tmp{*this};
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const _multimap_iterator& a, const _multimap_iterator& b) {
+            return a.current == b.current && a.index == b.index;
+        }
+
+        friend bool operator!=(const _multimap_iterator& a, const _multimap_iterator& b) {
+            return !(a == b);
+        }
+};
+
+// BST allowing duplicated keys: there is one node per key, holding the run of its values in a
+// small_list, so that a few values per key cost neither a node each nor a separate allocation.
+// Values of the same key are kept in insertion order.
+template <typename k, typename v, typename c = std::less<k>, std::size_t inline_values = 2>
+class bst_multimap {
+    using list_type = small_list<v, inline_values>;
+    using tree_type = bst<k, list_type, c>;
+    tree_type tree;
+    std::size_t values;
+
+    public:
+        bst_multimap(): tree{}, values{0} {};
+        bst_multimap(c comp): tree{comp}, values{0} {};
+
+        using iterator = _multimap_iterator<typename tree_type::iterator, k, v>;
+        using const_iterator = _multimap_iterator<typename tree_type::const_iterator, k, const v>;
+
+        iterator insert(const std::pair<k,v>& x) { return insert(std::pair<k,v>(x)); }
+        iterator insert(std::pair<k,v>&& x);
+
+        template<class... Types>
+        iterator emplace(Types&&... args) {return insert(std::pair<k,v>(std::forward<Types>(args)...));};
+
+        void clear() noexcept { tree.clear(); values = 0; }
+
+        iterator begin() noexcept { return iterator{tree.begin(), 0}; }
+        const_iterator begin() const noexcept { return const_iterator{tree.begin(), 0}; }
+        const_iterator cbegin() const noexcept { return const_iterator{tree.cbegin(), 0}; }
+
+        iterator end() noexcept { return iterator{tree.end(), 0}; }
+        const_iterator end() const noexcept { return const_iterator{tree.end(), 0}; }
+        const_iterator cend() const noexcept { return const_iterator{tree.cend(), 0}; }
+
+        // first value of the key, end() if missing
+        iterator find(const k& x) noexcept { return iterator{tree.find(x), 0}; }
+        const_iterator find(const k& x) const noexcept { return const_iterator{tree.find(x), 0}; }
+
+        std::pair<iterator, iterator> equal_range(const k& x) noexcept;
+        std::pair<const_iterator, const_iterator> equal_range(const k& x) const noexcept;
+
+        std::size_t count(const k& x) const noexcept {
+            auto it = tree.find(x);
+            return it == tree.end() ? 0 : (*it).second.size();
+        }
+
+        // removes every value of the key and returns how many they were
+        std::size_t erase(const k& x);
+
+        void balance() { tree.balance(); }
+        void setIncrementalBalance(bool on, double a = 0.7) { tree.setIncrementalBalance(on, a); }
+
+        std::size_t size() const noexcept { return values; }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const bst_multimap& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << (*it).second << " ";
+            return os;
+        }
+};
+
+template <typename k, typename v, typename c, std::size_t inline_values>
+typename bst_multimap<k,v,c,inline_values>::iterator bst_multimap<k,v,c,inline_values>::insert(std::pair<k,v>&& x) {
+    // a single descent: an existing key returns its node, and the empty list is not allocated
+    auto it = tree.insert({std::move(x.first), list_type{}}).first;
+    auto& list = (*it).second;
+    try {
+        list.push_back(std::move(x.second));
+    } catch(...) {
+        // a key without values would break find and count: the node goes if we just created it
+        if(list.empty())
+            tree.erase((*it).first);
+        throw;
+    }
+    ++values;
+    return iterator{it, list.size() - 1};
+}
+
+template <typename k, typename v, typename c, std::size_t inline_values>
+std::pair<typename bst_multimap<k,v,c,inline_values>::iterator, typename bst_multimap<k,v,c,inline_values>::iterator>
+bst_multimap<k,v,c,inline_values>::equal_range(const k& x) noexcept {
+    auto it = tree.find(x);
+    if(it == tree.end())
+        return std::make_pair(end(), end());
+    auto next = it;
+    return std::make_pair(iterator{it, 0}, iterator{++next, 0});
+}
+
+template <typename k, typename v, typename c, std::size_t inline_values>
+std::pair<typename bst_multimap<k,v,c,inline_values>::const_iterator, typename bst_multimap<k,v,c,inline_values>::const_iterator>
+bst_multimap<k,v,c,inline_values>::equal_range(const k& x) const noexcept {
+    auto it = tree.find(x);
+    if(it == tree.end())
+        return std::make_pair(end(), end());
+    auto next = it;
+    return std::make_pair(const_iterator{it, 0}, const_iterator{++next, 0});
+}
+
+template <typename k, typename v, typename c, std::size_t inline_values>
+std::size_t bst_multimap<k,v,c,inline_values>::erase(const k& x) {
+    auto n = count(x);
+    if(n > 0) {
+        tree.erase(x);
+        values -= n;
+    }
+    return n;
+}
+
+#endif
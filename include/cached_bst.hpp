@@ -0,0 +1,123 @@
+#ifndef __cached_bst_hpp
+#define __cached_bst_hpp
+
+#include <bst.hpp>
+#include <functional>
+#include <vector>
+
+// Front-end cache for skewed reads: a direct-mapped table of iterators, indexed by the hash of the
+// key, remembers the results of find. A hit costs one slot and one node instead of a full descent.
+// The wrapper owns the tree, so that every erase goes through it and clears the slot of the erased
+// key: the other slots stay valid because erase re-links the nodes without moving the values.
+// Keys equivalent for c must have the same hash for h, otherwise an erased node could stay cached
+// in the slot of an equivalent key and be read after being freed. Only the non-const find fills
+// the cache: the const one reads it and, like bst, is safe for concurrent readers.
+template <typename k, typename v, typename c = std::less<k>, typename h = std::hash<k>, std::size_t slots = 4096>
+class cached_bst {
+    using tree_type = bst<k,v,c>;
+    static_assert(slots > 0 && (slots & (slots - 1)) == 0, "cached_bst: slots must be a power of two");
+
+    public:
+        using iterator = typename tree_type::iterator;
+        using const_iterator = typename tree_type::const_iterator;
+
+    private:
+        tree_type tree;
+        c op;
+        h hash;
+        std::vector<iterator> cache;
+
+        // private functions
+        iterator& slot(const k& x) { return cache[hash(x) & (slots - 1)]; }
+        const iterator& slot(const k& x) const { return cache[hash(x) & (slots - 1)]; }
+        bool hit(const iterator& it, const k& x) const { return it != iterator{} && !op(x, (*it).first) && !op((*it).first, x); }
+        void flush() { cache.assign(slots, iterator{}); }
+
+    public:
+        cached_bst(): tree{}, op{c()}, hash{h()}, cache(slots) {};
+        cached_bst(c comp): tree{comp}, op{comp}, hash{h()}, cache(slots) {};
+
+        std::pair<iterator, bool> insert(const std::pair<const k,v>& x) { return tree.insert(x); }
+        std::pair<iterator, bool> insert(std::pair<const k,v>&& x) { return tree.insert(std::move(x)); }
+
+        template<class... Types>
+        std::pair<iterator,bool> emplace(Types&&... args) { return tree.emplace(std::forward<Types>(args)...); }
+
+        void clear() noexcept { tree.clear(); flush(); }
+
+        iterator begin() noexcept { return tree.begin(); }
+        const_iterator begin() const noexcept { return tree.begin(); }
+        const_iterator cbegin() const noexcept { return tree.cbegin(); }
+
+        iterator end() noexcept { return tree.end(); }
+        const_iterator end() const noexcept { return tree.end(); }
+        const_iterator cend() const noexcept { return tree.cend(); }
+
+        iterator find(const k& x) {
+            auto& it = slot(x);
+            if(!hit(it, x))
+                it = tree.find(x);
+            return it;
+        }
+
+        const_iterator find(const k& x) const {
+            const auto& it = slot(x);
+            if(hit(it, x))
+                return const_iterator{it.getCurrent()};
+            return tree.find(x);
+        }
+
+        void erase(const k& x) {
+            auto& it = slot(x);
+            if(hit(it, x))
+                it = iterator{};
+            tree.erase(x);
+        }
+
+        // rebuilding re-links the nodes: the cached iterators stay valid
+        void balance() { tree.balance(); }
+        void setIncrementalBalance(bool on, double a = 0.7) { tree.setIncrementalBalance(on, a); }
+
+        std::size_t size() const noexcept { return tree.size(); }
+
+        v& operator[](const k& x) {
+            auto it = find(x);
+            if(it != end())
+                return (*it).second;
+            return tree[x];
+        }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const cached_bst& x){
+            return os << x.tree;
+        }
+
+        void draw() { tree.draw(); }
+
+        // copy semantic: the copied nodes are new, so the copy starts with an empty cache
+        cached_bst(const cached_bst& b): tree{b.tree}, op{b.op}, hash{b.hash}, cache(slots) {}
+
+        cached_bst& operator=(const cached_bst& b) {
+            tree = b.tree;
+            op = b.op;
+            hash = b.hash;
+            flush();
+            return *this;
+        }
+
+        // move semantic: the nodes move along with the cache, the source is left empty
+        cached_bst(cached_bst&& b): tree{std::move(b.tree)}, op{std::move(b.op)}, hash{std::move(b.hash)}, cache{std::move(b.cache)} {
+            b.flush();
+        }
+
+        cached_bst& operator=(cached_bst&& b) {
+            tree = std::move(b.tree);
+            op = std::move(b.op);
+            hash = std::move(b.hash);
+            cache = std::move(b.cache);
+            b.flush();
+            return *this;
+        }
+};
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef __compact_bst_hpp
+#define __compact_bst_hpp
+
+#include <iostream>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Index used in place of pointers: 4 bytes instead of 8 on 64-bit builds.
+using compact_index = std::uint32_t;
+constexpr compact_index compact_nil = std::numeric_limits<compact_index>::max();
+
+// The store keeps the nodes in vectors and links them by index. Two layouts are available:
+// with split = true the keys and the child links sit in a "hot" array, while values and parents
+// are kept apart, so that find only touches the cache lines of the keys.
+template <typename k, typename v, bool split>
+class compact_store;
+
+template <typename k, typename v>
+class compact_store<k, v, true> {
+    struct hot {
+        k key;
+        compact_index left;
+        compact_index right;
+    };
+    std::vector<hot> hots;
+    std::vector<compact_index> parents;
+    std::vector<v> values;
+
+    public:
+        compact_index slots() const noexcept { return static_cast<compact_index>(hots.size()); }
+
+        compact_index push(k&& key, v&& value) {
+            hots.push_back(hot{std::move(key), compact_nil, compact_nil});
+            parents.push_back(compact_nil);
+            values.push_back(std::move(value));
+            return slots() - 1;
+        }
+
+        void clear() noexcept { hots.clear(); parents.clear(); values.clear(); }
+        void shrink() { hots.shrink_to_fit(); parents.shrink_to_fit(); values.shrink_to_fit(); }
+        void reserve(std::size_t n) { hots.reserve(n); parents.reserve(n); values.reserve(n); }
+
+        std::size_t memoryUsage() const noexcept {
+            return hots.capacity()*sizeof(hot) + parents.capacity()*sizeof(compact_index)
+                    + values.capacity()*sizeof(v);
+        }
+
+        // getters
+        k& getKey(compact_index i) { return hots[i].key; }
+        const k& getKey(compact_index i) const { return hots[i].key; }
+        v& getValue(compact_index i) { return values[i]; }
+        const v& getValue(compact_index i) const { return values[i]; }
+        compact_index getLeft(compact_index i) const { return hots[i].left; }
+        compact_index getRight(compact_index i) const { return hots[i].right; }
+        compact_index getParent(compact_index i) const { return parents[i]; }
+
+        // setters
+        void setLeft(compact_index i, compact_index x) { hots[i].left = x; }
+        void setRight(compact_index i, compact_index x) { hots[i].right = x; }
+        void setParent(compact_index i, compact_index x) { parents[i] = x; }
+};
+
+template <typename k, typename v>
+class compact_store<k, v, false> {
+    struct full {
+        k key;
+        v value;
+        compact_index left;
+        compact_index right;
+        compact_index parent;
+    };
+    std::vector<full> nodes;
+
+    public:
+        compact_index slots() const noexcept { return static_cast<compact_index>(nodes.size()); }
+
+        compact_index push(k&& key, v&& value) {
+            nodes.push_back(full{std::move(key), std::move(value), compact_nil, compact_nil, compact_nil});
+            return slots() - 1;
+        }
+
+        void clear() noexcept { nodes.clear(); }
+        void shrink() { nodes.shrink_to_fit(); }
+        void reserve(std::size_t n) { nodes.reserve(n); }
+
+        std::size_t memoryUsage() const noexcept { return nodes.capacity()*sizeof(full); }
+
+        // getters
+        k& getKey(compact_index i) { return nodes[i].key; }
+        const k& getKey(compact_index i) const { return nodes[i].key; }
+        v& getValue(compact_index i) { return nodes[i].value; }
+        const v& getValue(compact_index i) const { return nodes[i].value; }
+        compact_index getLeft(compact_index i) const { return nodes[i].left; }
+        compact_index getRight(compact_index i) const { return nodes[i].right; }
+        compact_index getParent(compact_index i) const { return nodes[i].parent; }
+
+        // setters
+        void setLeft(compact_index i, compact_index x) { nodes[i].left = x; }
+        void setRight(compact_index i, compact_index x) { nodes[i].right = x; }
+        void setParent(compact_index i, compact_index x) { nodes[i].parent = x; }
+};
+
+// Keys and values are not stored as a std::pair, therefore the iterator returns a pair of
+// references by value and operator-> goes through a small proxy.
+template <typename store_type, typename K, typename V>
+class _compact_iterator {
+    store_type* store;
+    compact_index current;
+
+    public:
+        _compact_iterator() noexcept: store{nullptr}, current{compact_nil} {};
+        _compact_iterator(store_type* s, compact_index x) noexcept: store{s}, current{x} {};
+
+        using value_type = std::pair<const K, V>;
+        using reference = std::pair<const K&, V&>;
+        struct pointer {
+            reference ref;
+            reference* operator->() noexcept { return &ref; }
+        };
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        reference operator*() const noexcept { return reference{store->getKey(current), store->getValue(current)}; }
+
+        pointer operator->() const noexcept { return pointer{*(*this)}; }
+
+        _compact_iterator& operator++() noexcept {  // pre increment
+            if(store->getRight(current) != compact_nil) {
+                current = store->getRight(current);
+                while(store->getLeft(current) != compact_nil)
+                    current = store->getLeft(current);
+            } else {
+                auto parent = store->getParent(current);
+                while(parent != compact_nil && store->getRight(parent) == current) {
+                    current = parent;
+                    parent = store->getParent(current);
+                }
+                current = parent;
+            }
+            return *this;
+        }
+
+        _compact_iterator operator++(int) noexcept {
+            _compact_iterator tmp{*this};
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const _compact_iterator& a, const _compact_iterator& b) {
+            return a.current == b.current;
+        }
+
+        friend bool operator!=(const _compact_iterator& a, const _compact_iterator& b) {
+            return !(a == b);
+        }
+
+        // getter
+        compact_index getCurrent() const {return current;}
+};
+
+// Interface of bst, but the nodes live in a vector-backed store and are linked through 32-bit
+// indices. Erased slots are recycled through a free list threaded on the left links. Unlike bst,
+// whose nodes never move, an insert that grows the store moves every value: it invalidates the
+// references returned by operator[] and by the iterators, while the iterators themselves,
+// which hold an index, stay valid until balance().
+template <typename k, typename v, typename c = std::less<k>, bool split = true>
+class compact_bst {
+    using store_type = compact_store<k, v, split>;
+    c op;
+    store_type store;
+    compact_index head;
+    compact_index freeList;
+    std::size_t count;
+
+    // private functions
+    compact_index allocate(k&& key, v&& value);
+    void transplant(compact_index x, compact_index y) noexcept;
+    compact_index balanceRec(std::vector<std::pair<k, v>>& values, std::size_t lo, std::size_t hi, compact_index parent);
+
+    public:
+        compact_bst(): op{c()}, head{compact_nil}, freeList{compact_nil}, count{0} {};
+        compact_bst(c comp): op{comp}, head{compact_nil}, freeList{compact_nil}, count{0} {};
+
+        using iterator = _compact_iterator<store_type, k, v>;
+        using const_iterator = _compact_iterator<const store_type, k, const v>;
+
+        std::pair<iterator, bool> insert(const std::pair<k, v>& x) { return insert(std::pair<k, v>(x)); }
+        std::pair<iterator, bool> insert(std::pair<k, v>&& x);
+
+        template<class... Types>
+        std::pair<iterator,bool> emplace(Types&&... args) {return insert(std::pair<k, v>(std::forward<Types>(args)...));};
+
+        void clear() noexcept { store.clear(); head = compact_nil; freeList = compact_nil; count = 0; }
+
+        iterator begin() noexcept { return iterator{&store, leftmost()}; }
+        const_iterator begin() const noexcept { return const_iterator{&store, leftmost()}; }
+        const_iterator cbegin() const noexcept { return const_iterator{&store, leftmost()}; }
+
+        iterator end() noexcept {return iterator{&store, compact_nil};}
+        const_iterator end() const noexcept { return const_iterator{&store, compact_nil};}
+        const_iterator cend() const noexcept { return const_iterator{&store, compact_nil};}
+
+        iterator find(const k& x) noexcept { return iterator{&store, findIndex(x)}; }
+        const_iterator find(const k& x) const noexcept { return const_iterator{&store, findIndex(x)}; }
+
+        void balance();
+        void erase(const k& x);
+
+        v& operator[](const k& x) {
+            auto i = findIndex(x);
+            if(i == compact_nil)
+                i = insert({x, v{}}).first.getCurrent();
+            return store.getValue(i);
+        }
+
+        std::size_t size() const noexcept { return count; }
+
+        // returns the spare capacity of the store, the free slots stay
+        void shrink_to_fit() { store.shrink(); }
+
+        // bytes reserved by the store, free slots included
+        std::size_t memoryUsage() const noexcept { return sizeof(*this) + store.memoryUsage(); }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const compact_bst& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << (*it).second << " ";
+            return os;
+        }
+
+    private:
+        compact_index leftmost() const noexcept;
+        compact_index findIndex(const k& x) const noexcept;
+};
+
+template <typename k, typename v, typename c, bool split>
+compact_index compact_bst<k,v,c,split>::leftmost() const noexcept {
+    auto i = head;
+    if(i != compact_nil)
+        while(store.getLeft(i) != compact_nil)
+            i = store.getLeft(i);
+    return i;
+}
+
+template <typename k, typename v, typename c, bool split>
+compact_index compact_bst<k,v,c,split>::findIndex(const k& x) const noexcept {
+    auto i = head;
+    while(i != compact_nil) {
+        const k& key = store.getKey(i);
+        if(op(key, x))
+            i = store.getRight(i);
+        else if(op(x, key))
+            i = store.getLeft(i);
+        else
+            return i;
+    }
+    return compact_nil;
+}
+
+template <typename k, typename v, typename c, bool split>
+compact_index compact_bst<k,v,c,split>::allocate(k&& key, v&& value) {
+    if(freeList != compact_nil) {
+        auto i = freeList;
+        freeList = store.getLeft(i);
+        store.getKey(i) = std::move(key);
+        store.getValue(i) = std::move(value);
+        store.setLeft(i, compact_nil);
+        store.setRight(i, compact_nil);
+        store.setParent(i, compact_nil);
+        return i;
+    }
+    if(store.slots() == compact_nil)
+        throw std::length_error("compact_bst: too many nodes for 32-bit indices");
+    return store.push(std::move(key), std::move(value));
+}
+
+template <typename k, typename v, typename c, bool split>
+std::pair<typename compact_bst<k,v,c,split>::iterator, bool> compact_bst<k,v,c,split>::insert(std::pair<k, v>&& x) {
+
+    auto parent = compact_nil;
+    auto tmp = head;
+    bool left = false;
+
+    while(tmp != compact_nil) {
+        parent = tmp;
+        if(op(x.first, store.getKey(tmp))) {
+            tmp = store.getLeft(tmp);
+            left = true;
+        } else if(op(store.getKey(tmp), x.first)) {
+            tmp = store.getRight(tmp);
+            left = false;
+        } else
+            return std::make_pair(iterator{&store, tmp}, false); //if the key already exist
+    }
+
+    tmp = allocate(std::move(x.first), std::move(x.second));
+    store.setParent(tmp, parent);
+    if(parent == compact_nil)
+        head = tmp;
+    else if(left)
+        store.setLeft(parent, tmp);
+    else
+        store.setRight(parent, tmp);
+    ++count;
+    return std::make_pair(iterator{&store, tmp}, true);
+}
+
+// Replaces the subtree rooted in x with the one rooted in y
+template <typename k, typename v, typename c, bool split>
+void compact_bst<k,v,c,split>::transplant(compact_index x, compact_index y) noexcept {
+    auto parent = store.getParent(x);
+    if(parent == compact_nil)
+        head = y;
+    else if(store.getLeft(parent) == x)
+        store.setLeft(parent, y);
+    else
+        store.setRight(parent, y);
+    if(y != compact_nil)
+        store.setParent(y, parent);
+}
+
+template <typename k, typename v, typename c, bool split>
+void compact_bst<k,v,c,split>::erase(const k& x) {
+
+    auto current = findIndex(x);
+    if(current == compact_nil)
+        return;
+
+    auto left = store.getLeft(current);
+    auto right = store.getRight(current);
+
+    if(left == compact_nil)
+        transplant(current, right);
+    else if(right == compact_nil)
+        transplant(current, left);
+    else { // node with two children: the successor takes its place
+        auto next = right;
+        while(store.getLeft(next) != compact_nil)
+            next = store.getLeft(next);
+        if(next != right) {
+            transplant(next, store.getRight(next));
+            store.setRight(next, right);
+            store.setParent(right, next);
+        }
+        transplant(current, next);
+        store.setLeft(next, left);
+        store.setParent(left, next);
+    }
+
+    // the slot goes in the free list
+    store.getValue(current) = v{};
+    store.setLeft(current, freeList);
+    freeList = current;
+    --count;
+}
+
+// Rebuilds the store from scratch: the free slots are dropped and the nodes are laid out in
+// pre-order, so that the first levels visited by find are contiguous in memory.
+template <typename k, typename v, typename c, bool split>
+void compact_bst<k,v,c,split>::balance() {
+
+    std::vector<std::pair<k, v>> values;
+    values.reserve(count);
+    for(auto i = leftmost(); i != compact_nil; i = (++iterator{&store, i}).getCurrent())
+        values.emplace_back(std::move(store.getKey(i)), std::move(store.getValue(i)));
+
+    clear();
+    store.shrink();
+    store.reserve(values.size());
+    head = balanceRec(values, 0, values.size(), compact_nil);
+    count = values.size();
+}
+
+template <typename k, typename v, typename c, bool split>
+compact_index compact_bst<k,v,c,split>::balanceRec(std::vector<std::pair<k, v>>& values, std::size_t lo, std::size_t hi, compact_index parent) {
+    if(lo == hi)
+        return compact_nil;
+
+    auto middle = lo + (hi - lo - 1)/2;
+    auto x = store.push(std::move(values[middle].first), std::move(values[middle].second));
+    store.setParent(x, parent);
+    store.setLeft(x, balanceRec(values, lo, middle, x));
+    store.setRight(x, balanceRec(values, middle + 1, hi, x));
+    return x;
+}
+
+#endif
@@ -0,0 +1,407 @@
+#ifndef __durable_bst_hpp
+#define __durable_bst_hpp
+
+#include <bst.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct durable_options {
+    std::size_t batch = 64;         // records per group commit, 1 commits every write
+    bool sync = true;               // fdatasync at each commit, false leaves the flush to the OS
+    std::size_t checkpointEvery = 0; // records after which checkpoint() is called, 0 never
+};
+
+// BST kept on disk with a write-ahead log and checkpoints, in two files: path.log and path.ckpt.
+// Every write appends to the log the record of its effect (the new value of the key, or its
+// erasure), so replaying a record twice is harmless. The records are buffered and written with a
+// single write and fdatasync every batch records: a crash loses at most the last batch, which is
+// the price of the throughput. checkpoint() dumps the sorted pairs in a new file, renames it over
+// the old checkpoint and empties the log. The constructor recovers the tree loading the checkpoint
+// with assignSorted, in linear time, and replaying the log, whose torn tail is dropped.
+// Keys and values are written byte by byte, so they have to be trivially copyable.
+template <typename k, typename v, typename c = std::less<k> >
+class durable_bst {
+    static_assert(std::is_trivially_copyable<k>::value && std::is_trivially_copyable<v>::value,
+                  "durable_bst: keys and values are stored as raw bytes");
+
+    using tree_type = bst<k,v,c>;
+    using pair_type = std::pair<const k, v>;
+    enum : std::uint8_t { put_record = 1, erase_record = 2 };
+    static constexpr std::size_t record_size = 1 + sizeof(k) + sizeof(v) + sizeof(std::uint32_t);
+    static constexpr std::uint32_t checkpoint_magic = 0x43545342; // "BSTC"
+
+    tree_type tree;
+    std::string path;
+    durable_options options;
+    int log;
+    std::vector<char> pending;
+    std::size_t pendingRecords;
+    std::size_t sinceCheckpoint;
+    bool damaged; // a failed commit left partial records in the log, only checkpoint() fixes it
+
+    // private functions
+    static std::uint32_t checksum(const char* data, std::size_t n) noexcept;
+    static void fail(const std::string& what) { throw std::system_error(errno, std::generic_category(), "durable_bst: " + what); }
+    static void writeAll(int fd, const char* data, std::size_t n);
+    static void syncDirectory(const std::string& file);
+    void append(std::uint8_t op, const k& key, const v& value);
+    void logged();
+    void load();
+    void replay();
+
+    public:
+        durable_bst(const std::string& p, durable_options o = durable_options{}, c comp = c{});
+        ~durable_bst();
+
+        durable_bst(const durable_bst&) = delete;
+        durable_bst& operator=(const durable_bst&) = delete;
+
+        using const_iterator = typename tree_type::const_iterator;
+
+        // Proxy returned by operator[]: the assignment goes through the log
+        class reference {
+            durable_bst& owner;
+            k key;
+            public:
+                reference(durable_bst& o, const k& x): owner{o}, key{x} {};
+                reference& operator=(const v& value) { owner.assign(key, value); return *this; }
+                operator v() const { auto it = owner.find(key); return it == owner.end() ? v{} : (*it).second; }
+        };
+
+        std::pair<const_iterator, bool> insert(const pair_type& x);
+        void assign(const k& key, const v& value);
+        void erase(const k& x);
+        reference operator[](const k& x) { return reference{*this, x}; }
+
+        const_iterator find(const k& x) const noexcept { return tree.find(x); }
+        const_iterator begin() const noexcept { return tree.begin(); }
+        const_iterator end() const noexcept { return tree.end(); }
+        std::size_t size() const noexcept { return tree.size(); }
+        const tree_type& view() const noexcept { return tree; }
+
+        // Writes the pending records to the log, and waits for the disk if options.sync
+        void commit();
+        // Dumps the tree and truncates the log
+        void checkpoint();
+        void balance() { tree.balance(); }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const durable_bst& x){
+            return os << x.tree;
+        }
+};
+
+template <typename k, typename v, typename c>
+durable_bst<k,v,c>::durable_bst(const std::string& p, durable_options o, c comp):
+    tree{comp}, path{p}, options{o}, log{-1}, pendingRecords{0}, sinceCheckpoint{0}, damaged{false} {
+    if(options.batch == 0)
+        options.batch = 1;
+    load();
+    log = ::open((path + ".log").c_str(), O_RDWR | O_CREAT, 0644);
+    if(log < 0)
+        fail("cannot open " + path + ".log");
+    try {
+        syncDirectory(path); // the log may have just been created
+        replay();
+    } catch(...) {
+        ::close(log);
+        throw;
+    }
+}
+
+//The last batch is committed, but a failure cannot be reported from here
+template <typename k, typename v, typename c>
+durable_bst<k,v,c>::~durable_bst() {
+    try {
+        commit();
+    } catch(...) {}
+    ::close(log);
+}
+
+//FNV-1a: it only has to tell a torn or stale record from a good one
+template <typename k, typename v, typename c>
+std::uint32_t durable_bst<k,v,c>::checksum(const char* data, std::size_t n) noexcept {
+    std::uint32_t h = 2166136261u;
+    for(std::size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::writeAll(int fd, const char* data, std::size_t n) {
+    while(n > 0) {
+        auto written = ::write(fd, data, n);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            fail("write failed");
+        }
+        data += written;
+        n -= static_cast<std::size_t>(written);
+    }
+}
+
+//Makes the creation and the renaming of the files in the directory of file durable
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::syncDirectory(const std::string& file) {
+    auto slash = file.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : file.substr(0, slash));
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0)
+        fail("cannot open the directory " + directory);
+    if(::fsync(fd) != 0) {
+        auto error = errno;
+        ::close(fd);
+        errno = error;
+        fail("fsync failed on the directory " + directory);
+    }
+    ::close(fd);
+}
+
+//The record is buffered before the tree is touched: if the tree throws, the caller drops it
+//resizing the buffer back to its previous size.
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::append(std::uint8_t op, const k& key, const v& value) {
+    auto start = pending.size();
+    pending.resize(start + record_size);
+    auto record = pending.data() + start;
+    record[0] = static_cast<char>(op);
+    std::memcpy(record + 1, &key, sizeof(k));
+    std::memcpy(record + 1 + sizeof(k), &value, sizeof(v));
+    auto sum = checksum(record, record_size - sizeof(std::uint32_t));
+    std::memcpy(record + record_size - sizeof(std::uint32_t), &sum, sizeof(sum));
+}
+
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::logged() {
+    ++pendingRecords;
+    ++sinceCheckpoint;
+    if(options.checkpointEvery > 0 && sinceCheckpoint >= options.checkpointEvery)
+        checkpoint();
+    else if(pendingRecords >= options.batch)
+        commit();
+}
+
+template <typename k, typename v, typename c>
+std::pair<typename durable_bst<k,v,c>::const_iterator, bool> durable_bst<k,v,c>::insert(const pair_type& x) {
+    auto it = find(x.first);
+    if(it != end())
+        return std::make_pair(it, false);
+    auto mark = pending.size();
+    append(put_record, x.first, x.second);
+    std::pair<typename tree_type::iterator, bool> p;
+    try {
+        p = tree.insert(x);
+    } catch(...) {
+        pending.resize(mark);
+        throw;
+    }
+    logged();
+    return std::make_pair(const_iterator{p.first.getCurrent()}, true);
+}
+
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::assign(const k& key, const v& value) {
+    auto mark = pending.size();
+    append(put_record, key, value);
+    try {
+        tree[key] = value;
+    } catch(...) {
+        pending.resize(mark);
+        throw;
+    }
+    logged();
+}
+
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::erase(const k& x) {
+    if(find(x) == end())
+        return;
+    append(erase_record, x, v{});
+    tree.erase(x);
+    logged();
+}
+
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::commit() {
+    if(damaged)
+        throw std::runtime_error("durable_bst: " + path + ".log holds a partial batch, call checkpoint()");
+    if(pending.empty())
+        return;
+    //a partial batch would misalign the records that follow it: the log is cut back on failure
+    auto offset = ::lseek(log, 0, SEEK_CUR);
+    if(offset < 0)
+        fail("cannot seek " + path + ".log");
+    try {
+        writeAll(log, pending.data(), pending.size());
+    } catch(...) {
+        if(::ftruncate(log, offset) != 0 || ::lseek(log, offset, SEEK_SET) < 0)
+            damaged = true;
+        throw;
+    }
+    pending.clear();
+    pendingRecords = 0;
+    if(options.sync && ::fdatasync(log) != 0)
+        fail("fdatasync failed on " + path + ".log");
+}
+
+//The new checkpoint is written aside and renamed over the old one, and the directory is synced, so
+//a crash leaves either of the two. The log is emptied only afterwards: if we crash in between, its
+//records are replayed on the new checkpoint, which already contains them, and the result does not
+//change.
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::checkpoint() {
+    std::vector<char> dump;
+    std::uint32_t magic = checkpoint_magic;
+    std::uint64_t n = tree.size();
+    dump.resize(sizeof(magic) + sizeof(n) + n*(sizeof(k) + sizeof(v)) + sizeof(std::uint32_t));
+    auto out = dump.data();
+    std::memcpy(out, &magic, sizeof(magic));
+    out += sizeof(magic);
+    std::memcpy(out, &n, sizeof(n));
+    out += sizeof(n);
+    for(const auto& x : tree) {
+        std::memcpy(out, &x.first, sizeof(k));
+        std::memcpy(out + sizeof(k), &x.second, sizeof(v));
+        out += sizeof(k) + sizeof(v);
+    }
+    auto sum = checksum(dump.data(), dump.size() - sizeof(sum));
+    std::memcpy(out, &sum, sizeof(sum));
+
+    auto tmp = path + ".ckpt.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        fail("cannot open " + tmp);
+    try {
+        writeAll(fd, dump.data(), dump.size());
+        if(::fsync(fd) != 0)
+            fail("fsync failed on " + tmp);
+    } catch(...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if(std::rename(tmp.c_str(), (path + ".ckpt").c_str()) != 0)
+        fail("cannot rename " + tmp);
+    syncDirectory(path);
+
+    pending.clear();
+    pendingRecords = 0;
+    sinceCheckpoint = 0;
+    if(::ftruncate(log, 0) != 0 || ::lseek(log, 0, SEEK_SET) < 0)
+        fail("cannot truncate " + path + ".log");
+    damaged = false;
+    if(options.sync && ::fdatasync(log) != 0)
+        fail("fdatasync failed on " + path + ".log");
+}
+
+//A missing checkpoint is an empty tree, a damaged one is an error: unlike the log tail, it was
+//complete when it was renamed.
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::load() {
+    int fd = ::open((path + ".ckpt").c_str(), O_RDONLY);
+    if(fd < 0) {
+        if(errno == ENOENT)
+            return;
+        fail("cannot open " + path + ".ckpt");
+    }
+    std::vector<char> dump;
+    struct stat info;
+    if(::fstat(fd, &info) == 0)
+        dump.resize(static_cast<std::size_t>(info.st_size));
+    std::size_t done = 0;
+    while(done < dump.size()) {
+        auto got = ::read(fd, dump.data() + done, dump.size() - done);
+        if(got <= 0) {
+            if(got < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    ::close(fd);
+
+    std::uint32_t magic = 0, sum = 0;
+    std::uint64_t n = 0;
+    const std::size_t header = sizeof(magic) + sizeof(n);
+    if(done == dump.size() && dump.size() >= header + sizeof(sum)) {
+        std::memcpy(&magic, dump.data(), sizeof(magic));
+        std::memcpy(&n, dump.data() + sizeof(magic), sizeof(n));
+        std::memcpy(&sum, dump.data() + dump.size() - sizeof(sum), sizeof(sum));
+    }
+    if(magic != checkpoint_magic || dump.size() != header + n*(sizeof(k) + sizeof(v)) + sizeof(sum)
+       || sum != checksum(dump.data(), dump.size() - sizeof(sum)))
+        throw std::runtime_error("durable_bst: damaged checkpoint " + path + ".ckpt");
+
+    std::vector<pair_type> values;
+    values.reserve(n);
+    auto in = dump.data() + header;
+    for(std::uint64_t i = 0; i < n; ++i) {
+        k key;
+        v value;
+        std::memcpy(&key, in, sizeof(k));
+        std::memcpy(&value, in + sizeof(k), sizeof(v));
+        values.emplace_back(key, value);
+        in += sizeof(k) + sizeof(v);
+    }
+    tree.assignSorted(std::move(values));
+}
+
+//Replays the complete records, then cuts the log after the last good one, so that the new records
+//are not appended after garbage.
+template <typename k, typename v, typename c>
+void durable_bst<k,v,c>::replay() {
+    std::vector<char> buffer(record_size*4096);
+    std::size_t filled = 0;
+    off_t good = 0;
+    bool torn = false;
+    while(!torn) {
+        auto got = ::read(log, buffer.data() + filled, buffer.size() - filled);
+        if(got < 0) {
+            if(errno == EINTR)
+                continue;
+            fail("cannot read " + path + ".log");
+        }
+        filled += static_cast<std::size_t>(got);
+        std::size_t i = 0;
+        for(; i + record_size <= filled; i += record_size) {
+            auto record = buffer.data() + i;
+            std::uint32_t sum;
+            std::memcpy(&sum, record + record_size - sizeof(sum), sizeof(sum));
+            if(sum != checksum(record, record_size - sizeof(sum)) || (record[0] != put_record && record[0] != erase_record)) {
+                torn = true;
+                break;
+            }
+            k key;
+            std::memcpy(&key, record + 1, sizeof(k));
+            if(record[0] == put_record) {
+                v value;
+                std::memcpy(&value, record + 1 + sizeof(k), sizeof(v));
+                tree[key] = value;
+            } else
+                tree.erase(key);
+            good += record_size;
+            ++sinceCheckpoint;
+        }
+        if(got == 0)
+            break;
+        std::memmove(buffer.data(), buffer.data() + i, filled - i);
+        filled -= i;
+    }
+    if(::ftruncate(log, good) != 0 || ::lseek(log, good, SEEK_SET) < 0)
+        fail("cannot truncate " + path + ".log");
+}
+
+#endif
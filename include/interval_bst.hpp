@@ -0,0 +1,235 @@
+#ifndef __interval_bst_hpp
+#define __interval_bst_hpp
+
+#include <bst.hpp>
+#include <stdexcept>
+#include <vector>
+
+template <typename k, typename v>
+struct interval_entry {
+    const k first; // start, the key of the tree
+    v second;
+    const k end;   // the interval is [first, end)
+    k maxEnd;      // largest end in the subtree, kept by interval_bst
+
+    interval_entry(const k& start, const k& e, v&& value): first{start}, second{std::move(value)}, end{e}, maxEnd{e} {};
+};
+
+// BST of half-open intervals [start, end) keyed by start, where every node also stores the largest
+// end of its subtree. A subtree whose largest end is not after the query cannot overlap it and is
+// skipped, as is the right subtree of a node starting after the query, so the overlapping
+// intervals are found in O(log n) each instead of scanning the tree. The largest ends are fixed
+// on the path from the changed node up on insert and erase, and bottom-up on a rebuild, through
+// the refresh hook of the node functions of bst. The incremental mode of bst (scapegoat) is on by
+// default with alpha 0.7, since time windows tend to arrive in order of start and would otherwise
+// make a list.
+template <typename k, typename v, typename c = std::less<k> >
+class interval_bst {
+    using entry_type = interval_entry<k,v>;
+    using node_type = node<entry_type>;
+    c op;
+    std::unique_ptr<node_type> head;
+    std::size_t count;
+    double alpha; // weight balance factor of the incremental mode, 0 when disabled
+
+    // private functions
+    node_type* findNode(const k& x) const noexcept;
+    void refresh(node_type* x) noexcept;
+    void refreshUp(node_type* x) noexcept;
+    auto refresher() noexcept { return [this](node_type* x) noexcept { refresh(x); }; }
+    void overlapping(node_type* x, const k& lo, const k& hi, bool point, std::vector<node_type*>& result) const;
+
+    public:
+        interval_bst(): op{c()}, head{nullptr}, count{0}, alpha{0.7} {};
+        interval_bst(c comp): op{comp}, head{nullptr}, count{0}, alpha{0.7} {};
+
+        using iterator = _iterator<node_type, entry_type>;
+        using const_iterator = _iterator<node_type, const entry_type>;
+
+        // Inserts [start, end) if no interval has the same start, throws if end is before start
+        std::pair<iterator, bool> insert(const k& start, const k& end, v value);
+
+        void clear() noexcept { head.reset(); count = 0; }
+
+        iterator begin() noexcept;
+        const_iterator begin() const noexcept { return const_iterator{const_cast<interval_bst*>(this)->begin().getCurrent()}; }
+        const_iterator cbegin() const noexcept { return begin(); }
+
+        iterator end() noexcept {return iterator{nullptr};}
+        const_iterator end() const noexcept { return const_iterator{nullptr};}
+        const_iterator cend() const noexcept { return const_iterator{nullptr};}
+
+        iterator find(const k& start) noexcept { return iterator{findNode(start)}; }
+        const_iterator find(const k& start) const noexcept { return const_iterator{findNode(start)}; }
+
+        // the intervals containing point, and the intervals overlapping [lo, hi), ordered by start
+        std::vector<iterator> query_overlapping(const k& point);
+        std::vector<const_iterator> query_overlapping(const k& point) const;
+        std::vector<iterator> query_overlapping(const k& lo, const k& hi);
+        std::vector<const_iterator> query_overlapping(const k& lo, const k& hi) const;
+
+        void erase(const k& start);
+        void balance() { if(head) rebuildSubtree(head, head.get(), refresher()); }
+        // as bst::setIncrementalBalance, on with alpha 0.7 unless disabled
+        void setIncrementalBalance(bool on, double a = 0.7);
+
+        std::size_t size() const noexcept { return count; }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const interval_bst& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << "[" << (*it).first << ", " << (*it).end << ") ";
+            return os;
+        }
+
+        // move semantic: the moved-from tree is empty
+        interval_bst(interval_bst&& b) noexcept: op{std::move(b.op)}, head{std::move(b.head)}, count{b.count}, alpha{b.alpha} { b.count = 0; }
+
+        interval_bst& operator=(interval_bst&& b) noexcept {
+            if(this != &b) {
+                op = std::move(b.op);
+                head = std::move(b.head);
+                count = b.count;
+                alpha = b.alpha;
+                b.count = 0;
+            }
+            return *this;
+        }
+};
+
+template <typename k, typename v, typename c>
+typename interval_bst<k,v,c>::node_type* interval_bst<k,v,c>::findNode(const k& x) const noexcept {
+    auto tmp = head.get();
+    while(tmp != nullptr) {
+        if(op(tmp->getValue().first, x))
+            tmp = tmp->getRight();
+        else if(op(x, tmp->getValue().first))
+            tmp = tmp->getLeft();
+        else
+            return tmp;
+    }
+    return nullptr;
+}
+
+template <typename k, typename v, typename c>
+typename interval_bst<k,v,c>::iterator interval_bst<k,v,c>::begin() noexcept {
+    auto tmp = head.get();
+    if(tmp != nullptr)
+        while(tmp->getLeft() != nullptr)
+            tmp = tmp->getLeft();
+    return iterator{tmp};
+}
+
+//The largest end of x from its own end and those of its children
+template <typename k, typename v, typename c>
+void interval_bst<k,v,c>::refresh(node_type* x) noexcept {
+    auto& entry = x->getValue();
+    entry.maxEnd = entry.end;
+    if(x->getLeft() && op(entry.maxEnd, x->getLeft()->getValue().maxEnd))
+        entry.maxEnd = x->getLeft()->getValue().maxEnd;
+    if(x->getRight() && op(entry.maxEnd, x->getRight()->getValue().maxEnd))
+        entry.maxEnd = x->getRight()->getValue().maxEnd;
+}
+
+template <typename k, typename v, typename c>
+void interval_bst<k,v,c>::refreshUp(node_type* x) noexcept {
+    for(; x != nullptr; x = x->getParent())
+        refresh(x);
+}
+
+//The new interval can only raise the largest ends of its ancestors, so we go up while it does
+template <typename k, typename v, typename c>
+std::pair<typename interval_bst<k,v,c>::iterator, bool> interval_bst<k,v,c>::insert(const k& start, const k& end, v value) {
+    if(op(end, start))
+        throw std::invalid_argument("interval_bst: the end of the interval is before its start");
+
+    node_type* parent = nullptr;
+    bool isLeft = false;
+    std::size_t depth = 0;
+    auto tmp = head.get();
+    while(tmp != nullptr) {
+        parent = tmp;
+        ++depth;
+        if(op(start, tmp->getValue().first)) {
+            isLeft = true;
+            tmp = tmp->getLeft();
+        } else if(op(tmp->getValue().first, start)) {
+            isLeft = false;
+            tmp = tmp->getRight();
+        } else
+            return std::make_pair(iterator{tmp}, false);
+    }
+
+    auto x = new node_type(parent, start, end, std::move(value));
+    attachNode(head, parent, isLeft, x);
+    for(auto y = parent; y != nullptr && op(y->getValue().maxEnd, end); y = y->getParent())
+        y->getValue().maxEnd = end;
+    ++count;
+    rebalanceInsert(head, x, depth, count, alpha, refresher());
+    return std::make_pair(iterator{x}, true);
+}
+
+//The largest ends change from the lowest node that lost a descendant up to the root
+template <typename k, typename v, typename c>
+void interval_bst<k,v,c>::erase(const k& start) {
+    auto current = findNode(start);
+    if(current == nullptr)
+        return;
+    refreshUp(eraseNode(head, current, refresher()));
+    --count;
+}
+
+template <typename k, typename v, typename c>
+void interval_bst<k,v,c>::setIncrementalBalance(bool on, double a) {
+    if(on && (a < 0.5 || a >= 1))
+        throw std::invalid_argument("interval_bst: alpha must be in [0.5, 1)");
+    alpha = on ? a : 0;
+    if(on)
+        balance(); // the height bound holds from now on
+}
+
+//In-order visit pruned by the largest ends: nothing in x ends after lo if its largest end does not,
+//and the right subtree starts after the start of x. A point p is the query [p, p] with the start
+//compared inclusively, a range [lo, hi) compares the start exclusively.
+template <typename k, typename v, typename c>
+void interval_bst<k,v,c>::overlapping(node_type* x, const k& lo, const k& hi, bool point, std::vector<node_type*>& result) const {
+    if(x == nullptr || !op(lo, x->getValue().maxEnd))
+        return;
+    overlapping(x->getLeft(), lo, hi, point, result);
+    const auto& entry = x->getValue();
+    if(point ? op(hi, entry.first) : !op(entry.first, hi))
+        return;
+    if(op(lo, entry.end))
+        result.push_back(x);
+    overlapping(x->getRight(), lo, hi, point, result);
+}
+
+template <typename k, typename v, typename c>
+std::vector<typename interval_bst<k,v,c>::iterator> interval_bst<k,v,c>::query_overlapping(const k& point) {
+    std::vector<node_type*> nodes;
+    overlapping(head.get(), point, point, true, nodes);
+    return std::vector<iterator>(nodes.begin(), nodes.end());
+}
+
+template <typename k, typename v, typename c>
+std::vector<typename interval_bst<k,v,c>::const_iterator> interval_bst<k,v,c>::query_overlapping(const k& point) const {
+    std::vector<node_type*> nodes;
+    overlapping(head.get(), point, point, true, nodes);
+    return std::vector<const_iterator>(nodes.begin(), nodes.end());
+}
+
+template <typename k, typename v, typename c>
+std::vector<typename interval_bst<k,v,c>::iterator> interval_bst<k,v,c>::query_overlapping(const k& lo, const k& hi) {
+    std::vector<node_type*> nodes;
+    overlapping(head.get(), lo, hi, false, nodes);
+    return std::vector<iterator>(nodes.begin(), nodes.end());
+}
+
+template <typename k, typename v, typename c>
+std::vector<typename interval_bst<k,v,c>::const_iterator> interval_bst<k,v,c>::query_overlapping(const k& lo, const k& hi) const {
+    std::vector<node_type*> nodes;
+    overlapping(head.get(), lo, hi, false, nodes);
+    return std::vector<const_iterator>(nodes.begin(), nodes.end());
+}
+
+#endif
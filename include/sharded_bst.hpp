@@ -0,0 +1,285 @@
+#ifndef __sharded_bst_hpp
+#define __sharded_bst_hpp
+
+#include <bst.hpp>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+template <typename tree_type, typename shard_array>
+class _sharded_iterator {
+    using tree_iterator = typename tree_type::const_iterator;
+    const shard_array* shards;
+    std::size_t index; // shard of current, the number of shards at the end
+    tree_iterator current;
+
+    // skips the empty shards
+    void settle() noexcept {
+        while(index < shards->size() && current == (*shards)[index].tree.cend())
+            if(++index < shards->size())
+                current = (*shards)[index].tree.cbegin();
+        if(index == shards->size())
+            current = tree_iterator{};
+    }
+
+    public:
+        _sharded_iterator() noexcept: shards{nullptr}, index{0}, current{} {};
+        _sharded_iterator(const shard_array* s, std::size_t i) noexcept: shards{s}, index{i}, current{} {
+            if(index < shards->size()) {
+                current = (*shards)[index].tree.cbegin();
+                settle();
+            }
+        };
+
+        using value_type = typename tree_iterator::value_type;
+        using reference = typename tree_iterator::reference;
+        using pointer = typename tree_iterator::pointer;
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        reference operator*() const noexcept { return *current; }
+
+        pointer operator->() const noexcept { return &(*current); }
+
+        _sharded_iterator& operator++() noexcept {  // pre increment
+            ++current;
+            settle();
+            return *this;
+        }
+
+        _sharded_iterator operator++(int) noexcept {
+            _sharded_iterator tmp{*this};
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const _sharded_iterator& a, const _sharded_iterator& b) {
+            return a.index == b.index && a.current == b.current;
+        }
+
+        friend bool operator!=(const _sharded_iterator& a, const _sharded_iterator& b) {
+            return !(a == b);
+        }
+};
+
+// Thread-safe map split by key range in N bst shards, each behind its own lock, so that writes to
+// different ranges proceed in parallel. The N-1 boundaries are guarded by a shared lock that every
+// operation holds in read mode; only a re-partition takes it in write mode. A re-partition starts
+// when an insert leaves a shard with more than skew times the average size (at least minShard
+// keys): the shards are rebuilt at the quantiles of the keys with assignSorted, so their sizes
+// grow geometrically between two re-partitions and the amortised cost per insert is constant.
+// Since the shards hold disjoint ranges in order, the global iteration visits them one after the
+// other; like the iterator of bst, it must not run together with the writers.
+template <typename k, typename v, typename c = std::less<k>, std::size_t N = 16>
+class sharded_bst {
+    static_assert(N > 0, "sharded_bst: at least one shard is needed");
+    using tree_type = bst<k,v,c>;
+    using pair_type = std::pair<const k, v>;
+    static constexpr std::size_t minShard = 1024;
+
+    // A cache line of padding after each shard keeps the lock and the tree of two shards on
+    // different lines. alignas would not do: in C++14 new ignores extended alignments, and this
+    // object is usually allocated on the heap to be shared between threads.
+    static constexpr std::size_t cache_line = 64;
+    struct shard {
+        mutable std::shared_timed_mutex lock;
+        tree_type tree;
+        char padding[cache_line];
+    };
+    using shard_array = std::array<shard, N>;
+
+    mutable std::shared_timed_mutex layout;
+    c op;
+    double skew;
+    std::vector<k> bounds; // shard i holds the keys in [bounds[i-1], bounds[i])
+    std::size_t limit;     // shard size that starts a re-partition
+    char padding[cache_line]; // keeps layout off the line of the first shard
+    shard_array shards;
+
+    // private functions
+    std::size_t route(const k& x) const {
+        return std::upper_bound(bounds.begin(), bounds.end(), x, op) - bounds.begin();
+    }
+    void repartition();
+    void checkSkew();
+
+    public:
+        sharded_bst(): sharded_bst(c()) {};
+        sharded_bst(c comp, double s = 2.0);
+
+        sharded_bst(const sharded_bst&) = delete;
+        sharded_bst& operator=(const sharded_bst&) = delete;
+
+        using const_iterator = _sharded_iterator<tree_type, shard_array>;
+        using iterator = const_iterator;
+
+        bool insert(const pair_type& x);
+        // inserts or overwrites, the equivalent of tree[key] = value
+        void assign(const k& key, const v& value);
+        void erase(const k& x);
+
+        // true and the value in result if the key is present
+        bool find(const k& x, v& result) const;
+        bool contains(const k& x) const;
+
+        std::size_t size() const;
+        std::array<std::size_t, N> shardSizes() const;
+
+        // Re-partitions at the quantiles of the keys, whatever the sizes of the shards
+        void rebalance();
+
+        const_iterator begin() const noexcept { return const_iterator{&shards, 0}; }
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator end() const noexcept { return const_iterator{&shards, N}; }
+        const_iterator cend() const noexcept { return end(); }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const sharded_bst& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << (*it).second << " ";
+            return os;
+        }
+};
+
+template <typename k, typename v, typename c, std::size_t N>
+sharded_bst<k,v,c,N>::sharded_bst(c comp, double s): op{comp}, skew{std::max(s, 1.0)}, limit{minShard} {
+    for(auto& x : shards)
+        x.tree = tree_type{comp};
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+bool sharded_bst<k,v,c,N>::insert(const pair_type& x) {
+    bool inserted, over;
+    {
+        std::shared_lock<std::shared_timed_mutex> guard{layout};
+        auto& s = shards[route(x.first)];
+        std::unique_lock<std::shared_timed_mutex> shardGuard{s.lock};
+        inserted = s.tree.insert(x).second;
+        over = s.tree.size() > limit;
+    }
+    if(over)
+        checkSkew();
+    return inserted;
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+void sharded_bst<k,v,c,N>::assign(const k& key, const v& value) {
+    bool over;
+    {
+        std::shared_lock<std::shared_timed_mutex> guard{layout};
+        auto& s = shards[route(key)];
+        std::unique_lock<std::shared_timed_mutex> shardGuard{s.lock};
+        s.tree[key] = value;
+        over = s.tree.size() > limit;
+    }
+    if(over)
+        checkSkew();
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+void sharded_bst<k,v,c,N>::erase(const k& x) {
+    std::shared_lock<std::shared_timed_mutex> guard{layout};
+    auto& s = shards[route(x)];
+    std::unique_lock<std::shared_timed_mutex> shardGuard{s.lock};
+    s.tree.erase(x);
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+bool sharded_bst<k,v,c,N>::find(const k& x, v& result) const {
+    std::shared_lock<std::shared_timed_mutex> guard{layout};
+    const auto& s = shards[route(x)];
+    std::shared_lock<std::shared_timed_mutex> shardGuard{s.lock};
+    auto it = s.tree.find(x);
+    if(it == s.tree.cend())
+        return false;
+    result = (*it).second;
+    return true;
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+bool sharded_bst<k,v,c,N>::contains(const k& x) const {
+    std::shared_lock<std::shared_timed_mutex> guard{layout};
+    const auto& s = shards[route(x)];
+    std::shared_lock<std::shared_timed_mutex> shardGuard{s.lock};
+    return s.tree.find(x) != s.tree.cend();
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+std::size_t sharded_bst<k,v,c,N>::size() const {
+    std::size_t n = 0;
+    for(auto x : shardSizes())
+        n += x;
+    return n;
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+std::array<std::size_t, N> sharded_bst<k,v,c,N>::shardSizes() const {
+    std::array<std::size_t, N> sizes;
+    std::shared_lock<std::shared_timed_mutex> guard{layout};
+    for(std::size_t i = 0; i < N; ++i) {
+        std::shared_lock<std::shared_timed_mutex> shardGuard{shards[i].lock};
+        sizes[i] = shards[i].tree.size();
+    }
+    return sizes;
+}
+
+template <typename k, typename v, typename c, std::size_t N>
+void sharded_bst<k,v,c,N>::rebalance() {
+    std::unique_lock<std::shared_timed_mutex> guard{layout};
+    repartition();
+}
+
+//Called without locks by a writer that saw its shard over the limit. Another writer may have
+//re-partitioned meanwhile, hence the limit is checked again under the lock.
+template <typename k, typename v, typename c, std::size_t N>
+void sharded_bst<k,v,c,N>::checkSkew() {
+    if(N == 1)
+        return;
+    std::unique_lock<std::shared_timed_mutex> guard{layout};
+    for(const auto& s : shards)
+        if(s.tree.size() > limit) {
+            repartition();
+            return;
+        }
+}
+
+//The caller holds layout in write mode, so no other operation is running and the shard locks are
+//not needed. The pairs are copied out in order and each new shard is built balanced from its slice
+//between two quantiles: the old shards are replaced only at the end, in case an allocation fails.
+template <typename k, typename v, typename c, std::size_t N>
+void sharded_bst<k,v,c,N>::repartition() {
+    std::vector<pair_type> values;
+    std::size_t n = 0;
+    for(const auto& s : shards)
+        n += s.tree.size();
+    values.reserve(n);
+    for(const auto& s : shards)
+        for(const auto& x : s.tree)
+            values.push_back(x);
+
+    // with less than N keys everything goes in the first shard
+    std::vector<k> newBounds;
+    if(n >= N)
+        for(std::size_t i = 1; i < N; ++i)
+            newBounds.push_back(values[i*n/N].first);
+
+    std::vector<tree_type> rebuilt;
+    rebuilt.reserve(N);
+    for(std::size_t i = 0; i < N; ++i) {
+        rebuilt.emplace_back(op);
+        auto lo = newBounds.empty() ? (i == 0 ? 0 : n) : i*n/N;
+        auto hi = newBounds.empty() ? n : (i + 1)*n/N;
+        if(hi > lo)
+            rebuilt.back().assignSorted(std::vector<pair_type>(values.begin() + lo, values.begin() + hi));
+    }
+
+    bounds = std::move(newBounds);
+    for(std::size_t i = 0; i < N; ++i)
+        shards[i].tree = std::move(rebuilt[i]);
+    limit = std::max(std::size_t{minShard}, static_cast<std::size_t>(skew*n/N));
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef __static_bst_hpp
+#define __static_bst_hpp
+
+#include <iostream>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+// std::pair is not assignable in a constant expression before C++20, hence our own pair.
+template <typename k, typename v>
+struct static_entry {
+    k first;
+    v second;
+};
+
+template <typename tree_type, typename T>
+class _static_iterator {
+    const tree_type* tree;
+    std::size_t current; // 1-based position in the array, 0 is the end
+
+    public:
+        constexpr _static_iterator() noexcept: tree{nullptr}, current{0} {};
+        constexpr _static_iterator(const tree_type* t, std::size_t x) noexcept: tree{t}, current{x} {};
+
+        using value_type = T;
+        using reference = const value_type&;
+        using pointer = const value_type*;
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr reference operator*() const noexcept { return tree->at(current); }
+
+        constexpr pointer operator->() const noexcept { return &(*(*this)); }
+
+        constexpr _static_iterator& operator++() noexcept {  // pre increment
+            current = tree->next(current);
+            return *this;
+        }
+
+        constexpr _static_iterator operator++(int) noexcept {
+            _static_iterator tmp{*this};
+            ++(*this);
+            return tmp;
+        }
+
+        friend constexpr bool operator==(const _static_iterator& a, const _static_iterator& b) {
+            return a.current == b.current;
+        }
+
+        friend constexpr bool operator!=(const _static_iterator& a, const _static_iterator& b) {
+            return !(a == b);
+        }
+
+        // getter
+        constexpr std::size_t getCurrent() const {return current;}
+};
+
+// Read-only tree built in a constexpr context. The entries are sorted at compile time and laid
+// out in a flat array in breadth-first (Eytzinger) order: the children of the 1-based position
+// i are 2i and 2i+1, so no link is stored and the top levels share the same cache lines.
+template <typename k, typename v, std::size_t N, typename c = std::less<k> >
+class static_bst {
+    static_assert(N > 0, "static_bst: at least one key is needed");
+    using entry_type = static_entry<k,v>;
+
+    entry_type entries[N];
+    c op;
+
+    // private functions
+    constexpr void layout(const entry_type* sorted, std::size_t& next, std::size_t i);
+    // levels of the implicit tree without missing nodes, floor(log2(N + 1))
+    static constexpr std::size_t fullLevels() noexcept {
+        std::size_t h = 0;
+        while((std::size_t{2} << h) - 1 <= N)
+            ++h;
+        return h;
+    }
+
+    public:
+        constexpr static_bst(const std::pair<k,v> (&items)[N], c comp = c{});
+
+        using const_iterator = _static_iterator<static_bst, entry_type>;
+        using iterator = const_iterator;
+
+        constexpr const_iterator begin() const noexcept;
+        constexpr const_iterator cbegin() const noexcept { return begin(); }
+
+        constexpr const_iterator end() const noexcept { return const_iterator{this, 0}; }
+        constexpr const_iterator cend() const noexcept { return end(); }
+
+        constexpr const_iterator find(const k& x) const noexcept;
+
+        constexpr std::size_t size() const noexcept { return N; }
+
+        // used by the iterator
+        constexpr const entry_type& at(std::size_t i) const noexcept { return entries[i - 1]; }
+        constexpr std::size_t next(std::size_t i) const noexcept;
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const static_bst& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << (*it).second << " ";
+            return os;
+        }
+};
+
+// Builds the tree deducing the number of entries: make_static_bst<int,int>({{1,10},{2,20}})
+template <typename k, typename v, typename c = std::less<k>, std::size_t N>
+constexpr static_bst<k,v,N,c> make_static_bst(const std::pair<k,v> (&items)[N], c comp = c{}) {
+    return static_bst<k,v,N,c>(items, comp);
+}
+
+//The constructor sorts a copy of the entries with an insertion sort (N is small and std::sort is
+//not constexpr in C++14), then fills the array with an in-order visit of the implicit tree.
+//A duplicated key throws: in a constant expression this is a compile time error.
+template <typename k, typename v, std::size_t N, typename c>
+constexpr static_bst<k,v,N,c>::static_bst(const std::pair<k,v> (&items)[N], c comp): entries{}, op{comp} {
+
+    entry_type sorted[N] {};
+    for(std::size_t i = 0; i < N; ++i) {
+        entry_type x {items[i].first, items[i].second};
+        std::size_t j = i;
+        while(j > 0 && op(x.first, sorted[j - 1].first)) {
+            sorted[j] = sorted[j - 1];
+            --j;
+        }
+        if(j > 0 && !op(sorted[j - 1].first, x.first))
+            throw std::invalid_argument("static_bst: duplicated key");
+        sorted[j] = x;
+    }
+
+    std::size_t next = 0;
+    layout(sorted, next, 1);
+}
+
+template <typename k, typename v, std::size_t N, typename c>
+constexpr void static_bst<k,v,N,c>::layout(const entry_type* sorted, std::size_t& next, std::size_t i) {
+    if(i > N)
+        return;
+    layout(sorted, next, 2*i);
+    entries[i - 1] = sorted[next++];
+    layout(sorted, next, 2*i + 1);
+}
+
+template <typename k, typename v, std::size_t N, typename c>
+constexpr typename static_bst<k,v,N,c>::const_iterator static_bst<k,v,N,c>::begin() const noexcept {
+    std::size_t i = 1;
+    while(2*i <= N)
+        i = 2*i;
+    return const_iterator{this, i};
+}
+
+//In-order successor: the leftmost node of the right subtree if any, otherwise we go up while we
+//are a right child (odd position) and once more.
+template <typename k, typename v, std::size_t N, typename c>
+constexpr std::size_t static_bst<k,v,N,c>::next(std::size_t i) const noexcept {
+    if(2*i + 1 <= N) {
+        i = 2*i + 1;
+        while(2*i <= N)
+            i = 2*i;
+        return i;
+    }
+    while(i & 1)
+        i >>= 1;
+    return i >> 1;
+}
+
+//The descent has a fixed depth and no data dependent branch: the comparison is added to the
+//position for each of the full levels, whose count is a constant, then once more on the last
+//level if it is partial, where a mask leaves the position of a missing node as it is (off the
+//tree) and reads the root instead. The last left turn is the smallest key not less than x,
+//and it is found by dropping the trailing right turns (the trailing ones of the position) and one
+//more bit.
+template <typename k, typename v, std::size_t N, typename c>
+constexpr typename static_bst<k,v,N,c>::const_iterator static_bst<k,v,N,c>::find(const k& x) const noexcept {
+    std::size_t i = 1;
+    for(std::size_t level = 0; level < fullLevels(); ++level)
+        i = 2*i + op(entries[i - 1].first, x);
+    if((std::size_t{1} << fullLevels()) <= N) { // a constant: the last level is partial
+        std::size_t inside = std::size_t{0} - (i <= N); // all ones on a node, zero off the tree
+        std::size_t right = op(entries[(i - 1) & inside].first, x);
+        i += inside & (i + right);
+    }
+    while(i & 1)
+        i >>= 1;
+    i >>= 1;
+    if(i == 0 || op(x, entries[i - 1].first))
+        return end();
+    return const_iterator{this, i};
+}
+
+#endif
@@ -0,0 +1,434 @@
+#ifndef __string_bst_hpp
+#define __string_bst_hpp
+
+#include <bst.hpp>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+// String with a larger small buffer than std::string: keys up to 28 bytes live inside the node,
+// and the object still takes 32 bytes. Longer keys are allocated without terminator.
+class inline_string {
+    static constexpr std::size_t inline_capacity = 28;
+    char buffer[inline_capacity]; // the bytes, or the pointer to them when they do not fit
+    std::uint32_t length;
+
+    // private functions
+    char* heap() const noexcept {
+        char* p;
+        std::memcpy(&p, buffer, sizeof(p));
+        return p;
+    }
+
+    void assign(const char* s, std::size_t n) {
+        if(n > UINT32_MAX)
+            throw std::length_error("inline_string: too long");
+        length = static_cast<std::uint32_t>(n);
+        if(n > inline_capacity) {
+            auto p = new char[n];
+            std::memcpy(p, s, n);
+            std::memcpy(buffer, &p, sizeof(p));
+        } else if(n > 0)
+            std::memcpy(buffer, s, n);
+    }
+
+    public:
+        inline_string() noexcept: length{0} {};
+        inline_string(const char* s, std::size_t n) { assign(s, n); }
+        inline_string(const char* s) { assign(s, std::strlen(s)); }
+        inline_string(const std::string& s) { assign(s.data(), s.size()); }
+        ~inline_string() { if(onHeap()) delete[] heap(); }
+
+        inline_string(const inline_string& s) { assign(s.data(), s.size()); }
+
+        inline_string(inline_string&& s) noexcept: length{s.length} {
+            std::memcpy(buffer, s.buffer, onHeap() ? sizeof(char*) : length);
+            s.length = 0;
+        }
+
+        inline_string& operator=(inline_string s) noexcept { // copy and move assignment
+            this->~inline_string();
+            new (this) inline_string(std::move(s));
+            return *this;
+        }
+
+        bool onHeap() const noexcept { return length > inline_capacity; }
+        const char* data() const noexcept { return onHeap() ? heap() : buffer; }
+        std::size_t size() const noexcept { return length; }
+        std::string str() const { return std::string(data(), length); }
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const inline_string& x){
+            return os.write(x.data(), x.size());
+        }
+};
+
+// Compares a and b starting from the byte from, where they are known to be equal, as unsigned bytes
+// (the order of std::string). Returns the length of the common prefix and sets sign like memcmp.
+inline std::size_t comparePrefix(const char* a, std::size_t na, const char* b, std::size_t nb, std::size_t from, int& sign) noexcept {
+    auto n = std::min(na, nb);
+    auto i = from;
+    while(i < n && a[i] == b[i])
+        ++i;
+    if(i < n)
+        sign = static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i]) ? -1 : 1;
+    else
+        sign = (na < nb) ? -1 : (na > nb);
+    return i;
+}
+
+template <typename v>
+struct string_entry {
+    const inline_string first;
+    v second;
+    std::uint32_t lcp; // length of the prefix shared with the key of the parent, kept by string_bst
+
+    string_entry(inline_string&& key, v&& value): first{std::move(key)}, second{std::move(value)}, lcp{0} {};
+};
+
+template <typename v>
+class frozen_string_bst;
+
+// BST specialised for string keys, ordered as std::string. Each node caches the length of the
+// prefix its key shares with the key of its parent. Descending, we know the common prefix m of the
+// searched key with the parent: if the child shares more than m with the parent, it compares with
+// the searched key like the parent did; if it shares less, the result is decided by the side of
+// the child; only when it shares exactly m we compare bytes, starting from m. Long shared prefixes
+// (as in URL paths) are therefore scanned about once per search instead of once per node.
+template <typename v>
+class string_bst {
+    using entry_type = string_entry<v>;
+    using node_type = node<entry_type>;
+    std::unique_ptr<node_type> head;
+    std::size_t count;
+
+    // private functions
+    node_type* findNode(const char* x, std::size_t n) const noexcept;
+    void refresh(node_type* x) noexcept;
+    auto refresher() noexcept { return [this](node_type* x) noexcept { refresh(x); }; }
+
+    public:
+        string_bst(): head{nullptr}, count{0} {};
+
+        using iterator = _iterator<node_type, entry_type>;
+        using const_iterator = _iterator<node_type, const entry_type>;
+
+        std::pair<iterator, bool> insert(std::pair<std::string, v>&& x);
+        std::pair<iterator, bool> insert(const std::pair<std::string, v>& x) { return insert(std::pair<std::string, v>(x)); }
+
+        template<class... Types>
+        std::pair<iterator,bool> emplace(Types&&... args) {return insert(std::pair<std::string, v>(std::forward<Types>(args)...));};
+
+        void clear() noexcept { head.reset(); count = 0; }
+
+        iterator begin() noexcept;
+        const_iterator begin() const noexcept { return const_iterator{const_cast<string_bst*>(this)->begin().getCurrent()}; }
+        const_iterator cbegin() const noexcept { return begin(); }
+
+        iterator end() noexcept {return iterator{nullptr};}
+        const_iterator end() const noexcept { return const_iterator{nullptr};}
+        const_iterator cend() const noexcept { return const_iterator{nullptr};}
+
+        iterator find(const std::string& x) noexcept { return iterator{findNode(x.data(), x.size())}; }
+        const_iterator find(const std::string& x) const noexcept { return const_iterator{findNode(x.data(), x.size())}; }
+
+        v& operator[](const std::string& x) {
+            auto n = findNode(x.data(), x.size());
+            if(n == nullptr)
+                n = insert({x, v{}}).first.getCurrent();
+            return n->getValue().second;
+        }
+
+        void erase(const std::string& x);
+        void balance() { if(head) rebuildSubtree(head, head.get(), refresher()); }
+
+        std::size_t size() const noexcept { return count; }
+
+        // bytes taken by the nodes and by the keys that do not fit inline, allocator overhead excluded
+        std::size_t memoryUsage() const noexcept;
+
+        // read-only copy with prefix compressed keys
+        frozen_string_bst<v> freeze() const;
+
+        friend
+        std::ostream& operator<<(std::ostream& os, const string_bst& x){
+            for(auto it = x.begin(); it != x.end(); ++it)
+                os << (*it).second << " ";
+            return os;
+        }
+
+        // copy semantic: the cached prefixes refer to the parents, which are copied in the same shape
+        string_bst(const string_bst& b): count{b.count} {
+            if(b.head)
+                head = std::make_unique<node_type>(b.head, nullptr);
+        }
+
+        string_bst& operator=(const string_bst& b) {
+            string_bst tmp{b};
+            *this = std::move(tmp);
+            return *this;
+        }
+
+        // move semantic
+        string_bst(string_bst&& b) noexcept: head{std::move(b.head)}, count{b.count} { b.count = 0; }
+
+        string_bst& operator=(string_bst&& b) noexcept {
+            if(this != &b) {
+                head = std::move(b.head);
+                count = b.count;
+                b.count = 0;
+            }
+            return *this;
+        }
+};
+
+// Read-only map of sorted keys with front coding: every key stores only the length of the prefix it
+// shares with the previous one and the remaining bytes. Every 16 keys a restart key is stored in
+// full, so that find is a binary search on the restarts followed by a scan of one block.
+template <typename v>
+class frozen_string_bst {
+    static constexpr std::size_t block_size = 16;
+    std::vector<char> bytes;
+    std::vector<std::uint32_t> restarts; // offset in bytes of the first key of each block
+    std::vector<v> values;
+
+    // private functions
+    static void putLength(std::vector<char>& out, std::size_t n);
+    static std::size_t getLength(const char*& in) noexcept;
+
+    public:
+        frozen_string_bst() = default;
+
+        // keys must be sorted and unique
+        template <typename It>
+        frozen_string_bst(It first, It last);
+
+        // pointer to the value of the key, nullptr if missing
+        const v* find(const std::string& x) const;
+
+        std::size_t size() const noexcept { return values.size(); }
+
+        std::size_t memoryUsage() const noexcept {
+            return sizeof(*this) + bytes.capacity() + restarts.capacity()*sizeof(std::uint32_t) + values.capacity()*sizeof(v);
+        }
+};
+
+///////////////////////////////
+/////                    //////
+/////  STRING BST        //////
+/////                    //////
+///////////////////////////////
+
+template <typename v>
+typename string_bst<v>::iterator string_bst<v>::begin() noexcept {
+    auto x = head.get();
+    if(x != nullptr)
+        while(x->getLeft() != nullptr)
+            x = x->getLeft();
+    return iterator{x};
+}
+
+template <typename v>
+typename string_bst<v>::node_type* string_bst<v>::findNode(const char* x, std::size_t n) const noexcept {
+    auto current = head.get();
+    if(current == nullptr)
+        return nullptr;
+
+    int sign = 0;
+    const auto& root = current->getValue().first;
+    std::size_t m = comparePrefix(x, n, root.data(), root.size(), 0, sign); //common prefix with the current node
+    while(sign != 0) {
+        bool toLeft = sign < 0;
+        auto child = toLeft ? current->getLeft() : current->getRight();
+        if(child == nullptr)
+            return nullptr;
+        auto& entry = child->getValue();
+        if(entry.lcp < m) { //the child differs from the parent, hence from x, before m
+            m = entry.lcp;
+            sign = toLeft ? 1 : -1;
+        } else if(entry.lcp == m)
+            m = comparePrefix(x, n, entry.first.data(), entry.first.size(), m, sign);
+        // otherwise the child agrees with the parent beyond m: same m and same sign
+        current = child;
+    }
+    return current;
+}
+
+template <typename v>
+std::pair<typename string_bst<v>::iterator, bool> string_bst<v>::insert(std::pair<std::string, v>&& x) {
+
+    if(head == nullptr) {
+        head = std::make_unique<node_type>(nullptr, inline_string(x.first), std::move(x.second));
+        count = 1;
+        return std::make_pair(iterator(head.get()), true);
+    }
+
+    //same descent of findNode, remembering the last node and the prefix shared with it
+    auto current = head.get();
+    int sign = 0;
+    const auto& root = current->getValue().first;
+    std::size_t m = comparePrefix(x.first.data(), x.first.size(), root.data(), root.size(), 0, sign);
+    while(sign != 0) {
+        bool toLeft = sign < 0;
+        auto child = toLeft ? current->getLeft() : current->getRight();
+        if(child == nullptr) {
+            auto tmp = new node_type(current, inline_string(x.first), std::move(x.second));
+            tmp->getValue().lcp = static_cast<std::uint32_t>(m);
+            if(toLeft)
+                current->setLeft(tmp);
+            else
+                current->setRight(tmp);
+            ++count;
+            return std::make_pair(iterator(tmp), true);
+        }
+        auto& entry = child->getValue();
+        if(entry.lcp < m) {
+            m = entry.lcp;
+            sign = toLeft ? 1 : -1;
+        } else if(entry.lcp == m)
+            m = comparePrefix(x.first.data(), x.first.size(), entry.first.data(), entry.first.size(), m, sign);
+        current = child;
+    }
+    return std::make_pair(iterator(current), false); //if the key already exist
+}
+
+//Recomputes the prefix cached in x after it changed parent
+template <typename v>
+void string_bst<v>::refresh(node_type* x) noexcept {
+    if(x == nullptr)
+        return;
+    auto parent = x->getParent();
+    if(parent == nullptr) {
+        x->getValue().lcp = 0;
+        return;
+    }
+    int sign;
+    const auto& a = x->getValue().first;
+    const auto& b = parent->getValue().first;
+    x->getValue().lcp = static_cast<std::uint32_t>(comparePrefix(a.data(), a.size(), b.data(), b.size(), 0, sign));
+}
+
+//Only the nodes that change parent need their cached prefix to be recomputed
+template <typename v>
+void string_bst<v>::erase(const std::string& x) {
+    auto current = findNode(x.data(), x.size());
+    if(current == nullptr)
+        return;
+    eraseNode(head, current, refresher());
+    --count;
+}
+
+template <typename v>
+std::size_t string_bst<v>::memoryUsage() const noexcept {
+    auto bytes = sizeof(*this) + count*sizeof(node_type);
+    for(auto it = begin(); it != end(); ++it)
+        if((*it).first.onHeap())
+            bytes += (*it).first.size();
+    return bytes;
+}
+
+template <typename v>
+frozen_string_bst<v> string_bst<v>::freeze() const {
+    std::vector<std::pair<std::string, v>> entries;
+    entries.reserve(count);
+    for(auto it = begin(); it != end(); ++it)
+        entries.emplace_back((*it).first.str(), (*it).second);
+    return frozen_string_bst<v>(entries.begin(), entries.end());
+}
+
+///////////////////////////////
+/////                    //////
+/////  FROZEN STRINGS    //////
+/////                    //////
+///////////////////////////////
+
+//Lengths are stored as varints: one byte for values below 128
+template <typename v>
+void frozen_string_bst<v>::putLength(std::vector<char>& out, std::size_t n) {
+    while(n >= 128) {
+        out.push_back(static_cast<char>((n & 127) | 128));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+template <typename v>
+std::size_t frozen_string_bst<v>::getLength(const char*& in) noexcept {
+    std::size_t n = 0;
+    unsigned shift = 0;
+    while(static_cast<unsigned char>(*in) & 128) {
+        n |= static_cast<std::size_t>(static_cast<unsigned char>(*in++) & 127) << shift;
+        shift += 7;
+    }
+    return n | static_cast<std::size_t>(static_cast<unsigned char>(*in++)) << shift;
+}
+
+template <typename v>
+template <typename It>
+frozen_string_bst<v>::frozen_string_bst(It first, It last) {
+    const std::string* previous = nullptr;
+    for(; first != last; ++first) {
+        const std::string& key = (*first).first;
+        std::size_t shared = 0;
+        if(values.size() % block_size == 0) {
+            if(bytes.size() > UINT32_MAX)
+                throw std::length_error("frozen_string_bst: too many bytes");
+            restarts.push_back(static_cast<std::uint32_t>(bytes.size()));
+        } else {
+            int sign;
+            shared = comparePrefix(previous->data(), previous->size(), key.data(), key.size(), 0, sign);
+        }
+        putLength(bytes, shared);
+        putLength(bytes, key.size() - shared);
+        bytes.insert(bytes.end(), key.begin() + shared, key.end());
+        values.push_back((*first).second);
+        previous = &key;
+    }
+    bytes.shrink_to_fit();
+    restarts.shrink_to_fit();
+    values.shrink_to_fit();
+}
+
+template <typename v>
+const v* frozen_string_bst<v>::find(const std::string& x) const {
+    if(values.empty())
+        return nullptr;
+
+    //last block whose restart key is not greater than x
+    std::size_t lo = 0;
+    std::size_t hi = restarts.size();
+    while(hi - lo > 1) {
+        auto middle = lo + (hi - lo)/2;
+        auto in = bytes.data() + restarts[middle];
+        getLength(in);
+        auto n = getLength(in);
+        int sign;
+        comparePrefix(x.data(), x.size(), in, n, 0, sign);
+        if(sign < 0)
+            hi = middle;
+        else
+            lo = middle;
+    }
+
+    //scan of the block, rebuilding each key on top of the previous one
+    std::string key;
+    auto in = bytes.data() + restarts[lo];
+    auto stop = lo + 1 < restarts.size() ? bytes.data() + restarts[lo + 1] : bytes.data() + bytes.size();
+    for(auto i = lo*block_size; in != stop; ++i) {
+        auto shared = getLength(in);
+        auto n = getLength(in);
+        key.resize(shared);
+        key.append(in, n);
+        in += n;
+        int sign;
+        comparePrefix(x.data(), x.size(), key.data(), key.size(), 0, sign);
+        if(sign == 0)
+            return &values[i];
+        if(sign < 0)
+            return nullptr;
+    }
+    return nullptr;
+}
+
+#endif
@@ -1,4 +1,9 @@
 #include <bst.hpp>
+#include <compact_bst.hpp>
+#include <static_bst.hpp>
+#include <bst_multimap.hpp>
+#include <string_bst.hpp>
+#include <interval_bst.hpp>
 
 int main(){
     try{ 
@@ -171,6 +176,100 @@ int main(){
         t3.draw();
         std::cout << std::endl;
 
+        std::cout << "Self-adjusting mode on t3: find moves the found node towards the root -> t3.find(3)" << std::endl;
+        t3.setSelfAdjusting(true);
+        t3.find(3);
+        t3.draw();
+        std::cout << std::endl;
+
+        std::cout << "Compact tree: nodes in a vector linked by 32-bit indices" << std::endl;
+        compact_bst<int, int> compact;
+        for(auto x : {8, 3, 6, 1, 10, 7, 14, 4, 13})
+            compact.insert({x,x});
+        std::cout << "compact: " << compact << std::endl;
+        std::cout << "Delete a node with 2 children and a leaf -> compact.erase(3), compact.erase(13)" << std::endl;
+        compact.erase(3);
+        compact.erase(13);
+        std::cout << "compact: " << compact << std::endl;
+        std::cout << "Reuse the free slots -> compact[2] = 2, compact.emplace(20,20)" << std::endl;
+        compact[2] = 2;
+        compact.emplace(20,20);
+        compact.balance();
+        std::cout << "compact after balance: " << compact << "(" << compact.size() << " nodes)" << std::endl;
+        std::cout << std::endl;
+
+        std::cout << "Multimap: duplicated keys share a node -> grades.emplace(...)" << std::endl;
+        bst_multimap<std::string, int> grades;
+        grades.emplace("Rossi", 28);
+        grades.emplace("Verdi", 30);
+        grades.emplace("Rossi", 24);
+        grades.emplace("Rossi", 30);
+        std::cout << "grades: " << grades << "(" << grades.size() << " values)" << std::endl;
+        std::cout << "grades.count(\"Rossi\"): " << grades.count("Rossi") << std::endl;
+        std::cout << "equal_range(\"Rossi\"): ";
+        auto range = grades.equal_range("Rossi");
+        for(auto it = range.first; it != range.second; ++it)
+            std::cout << (*it).second << " ";
+        std::cout << std::endl;
+        std::cout << "grades.erase(\"Rossi\"): " << grades.erase("Rossi") << " values removed" << std::endl;
+        std::cout << "grades: " << grades << std::endl;
+        std::cout << std::endl;
+
+        std::cout << "String tree: keys inline in the node and cached common prefixes" << std::endl;
+        string_bst<int> routes;
+        routes.emplace("/v1/customers/42/orders", 1);
+        routes.emplace("/v1/customers/42/invoices", 2);
+        routes.emplace("/v1/customers/7/orders", 3);
+        routes.emplace("/v1/products/this/path/does/not/fit/inline", 4);
+        routes["/v1/customers"] = 5;
+        routes.erase("/v1/customers/42/orders");
+        routes.balance();
+        for(auto it = routes.begin(); it != routes.end(); ++it)
+            std::cout << (*it).first << " -> " << (*it).second << std::endl;
+        auto frozenRoutes = routes.freeze();
+        std::cout << "Frozen copy, find(\"/v1/customers/7/orders\"): " << *frozenRoutes.find("/v1/customers/7/orders") << std::endl;
+        std::cout << std::endl;
+
+        std::cout << "Static tree built at compile time from {key, value} pairs" << std::endl;
+        constexpr auto table = make_static_bst<int, int>({{8,80}, {3,30}, {6,60}, {1,10}, {10,100}, {7,70}, {14,140}, {4,40}, {13,130}});
+        static_assert(table.find(6) != table.end() && (*table.find(6)).second == 60, "key 6 is in the table");
+        static_assert(table.find(5) == table.end(), "key 5 is not in the table");
+        std::cout << "table: " << table << std::endl;
+        std::cout << "table.find(13): " << (*table.find(13)).second << std::endl;
+        std::cout << std::endl;
+
+        std::cout << "Cursor: an export in batches of 3, with erase and insert between the batches" << std::endl;
+        bst<int,int,std::less<int>> exported;
+        for(int i = 1; i <= 10; ++i)
+            exported.insert({i, 10*i});
+        auto cursor = exported.cursor();
+        auto print = [](const std::pair<const int,int>& x){ std::cout << x.first << " "; };
+        cursor.next(3, print); // 1 2 3
+        std::cout << "| ";
+        exported.erase(3);     // the last key returned is gone
+        exported.erase(4);
+        exported.insert({11, 110});
+        while(cursor.next(3, print) > 0)
+            std::cout << "| ";
+        std::cout << std::endl << std::endl;
+
+        std::cout << "Interval tree: time windows [start, end) and the largest end of each subtree" << std::endl;
+        interval_bst<int,std::string> windows;
+        windows.insert(9, 12, "standup");
+        windows.insert(10, 11, "review");
+        windows.insert(11, 14, "deploy");
+        windows.insert(14, 15, "retro");
+        windows.insert(13, 18, "on call");
+        windows.erase(14);
+        std::cout << "windows: " << windows << std::endl;
+        std::cout << "query_overlapping(11): ";
+        for(auto it : windows.query_overlapping(11))
+            std::cout << (*it).second << " ";
+        std::cout << std::endl << "query_overlapping(14, 20): ";
+        for(auto it : windows.query_overlapping(14, 20))
+            std::cout << (*it).second << " ";
+        std::cout << std::endl << std::endl;
+
     } catch(const std::exception &e) {
         std::cerr << e.what() << std::endl;
         return 1;